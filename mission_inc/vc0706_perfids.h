@@ -14,6 +14,17 @@
 
 #define VC0706_PERF_ID              93 
 
+/* Capture hot path, in the child and storage tasks */
+#define VC0706_SETTINGS_PERF_ID     94  /* WRITE_DATA / DOWNSIZE_CTRL setting change */
+#define VC0706_VERSION_PERF_ID      95  /* GEN_VERSION probe */
+#define VC0706_LED_PERF_ID          96  /* LED warm-up before freezing */
+#define VC0706_FREEZE_PERF_ID       97  /* FBUF_CTRL stop current frame */
+#define VC0706_LENGTH_PERF_ID       98  /* GET_FBUF_LEN */
+#define VC0706_CHUNK_PERF_ID        99  /* One READ_FBUF chunk, header to tail */
+#define VC0706_WRITE_PERF_ID        100 /* Writing one chunk to the image file */
+#define VC0706_RESUME_PERF_ID       101 /* FBUF_CTRL resume frame */
+#define VC0706_NOTIFY_PERF_ID       102 /* Image name sent to TIM over the software bus */
+
 #endif /* _vc0706_perfids_h_ */
 
 /************************/
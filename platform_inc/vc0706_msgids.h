@@ -15,6 +15,8 @@
 #define VC0706_CMD_MID            	0x1888
 #define VC0706_SEND_HK_MID        	0x1889
 #define VC0706_HK_TLM_MID		0x0889
+#define VC0706_CAPTURE_TLM_MID		0x088A
+#define VC0706_WAKEUP_MID         	0x188B
 
 #endif /* _vc0706_msgids_h_ */
 
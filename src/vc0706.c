@@ -3,16 +3,38 @@
  * \brief The core logic for the VC0706 cFS app
  */
 #include "vc0706.h"
+#include "vc0706_catalog.h"
 #include "vc0706_child.h"
+#include "vc0706_plan.h"
+#include "vc0706_sched.h"
+#include "vc0706_timing.h"
 
 vc0706_hk_tlm_t VC0706_HkTelemetryPkt;     /**< The housekeeping telemetry packet for this app */
+vc0706_capture_tlm_t VC0706_CaptureTlmPkt; /**< The capture performance telemetry packet for this app */
 CFE_SB_PipeId_t VC0706_CommandPipe;        /**< The software bus command pipe for this app */
 CFE_SB_MsgPtr_t VC0706MsgPtr;              /**< Used to store a pointer to a message received over the software bus */
 uint32 VC0706_ChildTaskID;                 /**< The task ID for VC0706_ChildTask */
-VC0706_IMAGE_CMD_PKT_t VC0706_ImageCmdPkt; /**< Struct to store image command for VC0706_SendTimFileName */
 led_t led;                                 /**< Represents the LED flash for the camera */
-Camera_t cam;                              /**< Represents one of the two cameras */
-// TODO: Implement second camera
+Camera_t cams[VC0706_MAX_CAMERAS];         /**< The cameras, indexed by the ttyAMA interface they're plugged into */
+VC0706_Config_t VC0706_Config =            /**< Capture settings, changed by ground command */
+    {
+        VC0706_DEFAULT_CAMERAS,
+        VC0706_MODE_CONTINUOUS,
+        VC0706_DEFAULT_MOTION_WINDOW_MS,
+        VC0706_DEFAULT_MOTION_SENSITIVITY,
+        VC0706_DEFAULT_SIZE_TARGET,
+        SIZE640,
+        DOWNSIZE_NONE,
+        VC0706_DEFAULT_PERIOD_MS,
+        VC0706_DEFAULT_RETRY_BUDGET,
+        VC0706_RETRY_GIVE_UP,
+        VC0706_DEFAULT_PROBE_IDLE_MS,
+        false,
+        0,
+        VC0706_DEFAULT_STORE_QUOTA_BYTES,
+        VC0706_DEFAULT_STORE_QUOTA_IMAGES,
+        VC0706_FORMAT_FILES,
+};
 
 static CFE_EVS_BinFilter_t VC0706_EventFilters[] =
     {
@@ -21,6 +43,10 @@ static CFE_EVS_BinFilter_t VC0706_EventFilters[] =
         {VC0706_COMMAND_ERR_EID, 0x0000},
         {VC0706_COMMANDNOP_INF_EID, 0x0000},
         {VC0706_COMMANDRST_INF_EID, 0x0000},
+        {VC0706_COMMANDCFG_INF_EID, 0x0000},
+        {VC0706_PLAN_ERR_EID, 0x0000},
+        {VC0706_PLAN_INF_EID, 0x0000},
+        {VC0706_IMAGE_ERR_EID, 0x0000},
 };
 
 /**
@@ -71,9 +97,20 @@ void VC0706_AppInit()
     CFE_SB_CreatePipe(&VC0706_CommandPipe, VC0706_PIPE_DEPTH, "VC0706_CMD_PIPE");
     CFE_SB_Subscribe(VC0706_CMD_MID, VC0706_CommandPipe);
     CFE_SB_Subscribe(VC0706_SEND_HK_MID, VC0706_CommandPipe);
+    CFE_SB_Subscribe(VC0706_WAKEUP_MID, VC0706_CommandPipe);
+
+    // The timing samples are shared by every task, so they must be ready before any of them start
+    VC0706_TimingInit();
 
     VC0706_ResetCounters();
 
+    // Register the capture plan before the capture task starts reading it
+    VC0706_PlanInit();
+
+    CFE_SB_InitMsg(&VC0706_CaptureTlmPkt,
+                   VC0706_CAPTURE_TLM_MID,
+                   VC0706_CAPTURE_TLM_LNGTH, TRUE);
+
     VC0706_ChildInit();
 
     CFE_SB_InitMsg(&VC0706_HkTelemetryPkt,
@@ -105,6 +142,10 @@ void VC0706_ProcessCommandPacket(void)
         VC0706_ReportHousekeeping();
         break;
 
+    case VC0706_WAKEUP_MID:
+        VC0706_SchedTrigger(VC0706_TRIGGER_WAKEUP, 1);
+        break;
+
     default:
         VC0706_HkTelemetryPkt.vc0706_command_error_count++;
         CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
@@ -137,6 +178,66 @@ void VC0706_ProcessGroundCommand(void)
         VC0706_ResetCounters();
         break;
 
+    case VC0706_SET_CAMERA_COUNT_CC:
+        VC0706_SetCameraCount();
+        break;
+
+    case VC0706_SET_CAPTURE_MODE_CC:
+        VC0706_SetCaptureMode();
+        break;
+
+    case VC0706_SET_MOTION_PARAMS_CC:
+        VC0706_SetMotionParams();
+        break;
+
+    case VC0706_SET_SIZE_TARGET_CC:
+        VC0706_SetSizeTarget();
+        break;
+
+    case VC0706_SET_RESOLUTION_CC:
+        VC0706_SetResolution();
+        break;
+
+    case VC0706_SET_PERIOD_CC:
+        VC0706_SetPeriod();
+        break;
+
+    case VC0706_BURST_CC:
+        VC0706_Burst();
+        break;
+
+    case VC0706_DUMP_TIMING_CC:
+        VC0706_DumpTiming();
+        break;
+
+    case VC0706_SET_RETRY_CC:
+        VC0706_SetRetry();
+        break;
+
+    case VC0706_SET_PROBE_IDLE_CC:
+        VC0706_SetProbeIdle();
+        break;
+
+    case VC0706_SET_THUMBNAILS_CC:
+        VC0706_SetThumbnails();
+        break;
+
+    case VC0706_SET_DEDUP_CC:
+        VC0706_SetDedup();
+        break;
+
+    case VC0706_SET_STORE_QUOTA_CC:
+        VC0706_SetStoreQuota();
+        break;
+
+    case VC0706_SET_IMAGE_STATUS_CC:
+        VC0706_SetImageStatus();
+        break;
+
+    case VC0706_SET_STORAGE_FORMAT_CC:
+        VC0706_SetStorageFormat();
+        break;
+
     /* default case already found during FC vs length test */
     default:
         break;
@@ -144,14 +245,408 @@ void VC0706_ProcessGroundCommand(void)
     return;
 }
 
+/**
+ * Sets how many cameras the app drives (VC0706_SET_CAMERA_COUNT_CC)
+ */
+void VC0706_SetCameraCount(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetCameraCountCmd_t)))
+        return;
+
+    VC0706_SetCameraCountCmd_t *cmd = (VC0706_SetCameraCountCmd_t *)VC0706MsgPtr;
+    if (cmd->CameraCount < 1 || cmd->CameraCount > VC0706_TIM_CAMERAS)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
+                          "VC0706: invalid camera count %d, expected 1 - %d", cmd->CameraCount, VC0706_TIM_CAMERAS);
+        return;
+    }
+
+    VC0706_Config.cameraCount = cmd->CameraCount;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: camera count set to %d", VC0706_Config.cameraCount);
+}
+
+/**
+ * Selects continuous, motion-triggered, periodic or wakeup-driven capture (VC0706_SET_CAPTURE_MODE_CC)
+ */
+void VC0706_SetCaptureMode(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetCaptureModeCmd_t)))
+        return;
+
+    VC0706_SetCaptureModeCmd_t *cmd = (VC0706_SetCaptureModeCmd_t *)VC0706MsgPtr;
+    if (cmd->Mode > VC0706_MODE_WAKEUP)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR, "VC0706: invalid capture mode %d", cmd->Mode);
+        return;
+    }
+
+    VC0706_Config.captureMode = cmd->Mode;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: capture mode set to %d", VC0706_Config.captureMode);
+}
+
+/**
+ * Sets the motion trigger window and sensitivity (VC0706_SET_MOTION_PARAMS_CC)
+ */
+void VC0706_SetMotionParams(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetMotionParamsCmd_t)))
+        return;
+
+    VC0706_SetMotionParamsCmd_t *cmd = (VC0706_SetMotionParamsCmd_t *)VC0706MsgPtr;
+    if (cmd->WindowMs == 0 || cmd->Sensitivity < 1 || cmd->Sensitivity > VC0706_MAX_MOTION_SENSITIVITY)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
+                          "VC0706: invalid motion params window %d ms sensitivity %d, expected 1 - %d",
+                          cmd->WindowMs, cmd->Sensitivity, VC0706_MAX_MOTION_SENSITIVITY);
+        return;
+    }
+
+    VC0706_Config.motionWindowMs = cmd->WindowMs;
+    VC0706_Config.motionSensitivity = cmd->Sensitivity;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: motion window set to %d ms, sensitivity %d", cmd->WindowMs, cmd->Sensitivity);
+}
+
+/**
+ * Sets the frame size budget for the compression controller (VC0706_SET_SIZE_TARGET_CC)
+ */
+void VC0706_SetSizeTarget(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetSizeTargetCmd_t)))
+        return;
+
+    VC0706_SetSizeTargetCmd_t *cmd = (VC0706_SetSizeTargetCmd_t *)VC0706MsgPtr;
+    if (cmd->TargetBytes > VC0706_MAX_FRAME_LEN)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
+                          "VC0706: invalid size target %u, expected 0 - %u", (unsigned int)cmd->TargetBytes, VC0706_MAX_FRAME_LEN);
+        return;
+    }
+
+    VC0706_Config.sizeTargetBytes = cmd->TargetBytes;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: frame size target set to %u bytes", (unsigned int)VC0706_Config.sizeTargetBytes);
+}
+
+/**
+ * Sets the camera resolution and downsize level (VC0706_SET_RESOLUTION_CC)
+ */
+void VC0706_SetResolution(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetResolutionCmd_t)))
+        return;
+
+    VC0706_SetResolutionCmd_t *cmd = (VC0706_SetResolutionCmd_t *)VC0706MsgPtr;
+    bool sizeValid = cmd->ImageSize == SIZE640 || cmd->ImageSize == SIZE320 || cmd->ImageSize == SIZE160;
+    bool downsizeValid = cmd->Downsize == DOWNSIZE_NONE || cmd->Downsize == DOWNSIZE_HALF || cmd->Downsize == DOWNSIZE_QUARTER;
+    if (!sizeValid || !downsizeValid)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
+                          "VC0706: invalid resolution size 0x%02x downsize 0x%02x", cmd->ImageSize, cmd->Downsize);
+        return;
+    }
+
+    VC0706_Config.imageSize = cmd->ImageSize;
+    VC0706_Config.downsize = cmd->Downsize;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: resolution set to size 0x%02x downsize 0x%02x", cmd->ImageSize, cmd->Downsize);
+}
+
+/**
+ * Sets the capture period for periodic capture (VC0706_SET_PERIOD_CC)
+ */
+void VC0706_SetPeriod(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetPeriodCmd_t)))
+        return;
+
+    VC0706_SetPeriodCmd_t *cmd = (VC0706_SetPeriodCmd_t *)VC0706MsgPtr;
+    if (cmd->PeriodMs < VC0706_MIN_PERIOD_MS)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
+                          "VC0706: invalid period %u ms, expected at least %d", (unsigned int)cmd->PeriodMs, VC0706_MIN_PERIOD_MS);
+        return;
+    }
+
+    VC0706_Config.periodMs = cmd->PeriodMs;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: capture period set to %u ms", (unsigned int)VC0706_Config.periodMs);
+}
+
+/**
+ * Requests a burst of captures on top of the capture mode (VC0706_BURST_CC)
+ */
+void VC0706_Burst(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_BurstCmd_t)))
+        return;
+
+    VC0706_BurstCmd_t *cmd = (VC0706_BurstCmd_t *)VC0706MsgPtr;
+    if (cmd->Count < 1 || cmd->Count > VC0706_MAX_BURST)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
+                          "VC0706: invalid burst count %d, expected 1 - %d", cmd->Count, VC0706_MAX_BURST);
+        return;
+    }
+
+    VC0706_SchedTrigger(VC0706_TRIGGER_BURST, cmd->Count);
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: burst of %d captures requested", cmd->Count);
+}
+
+/**
+ * Writes the capture phase timing summary to VC0706_TIMING_FILE as CSV (VC0706_DUMP_TIMING_CC)
+ */
+void VC0706_DumpTiming(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_NoArgsCmd_t)))
+        return;
+
+    if (VC0706_TimingDump(VC0706_TIMING_FILE) != 0)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR, "VC0706: could not write %s", VC0706_TIMING_FILE);
+        return;
+    }
+
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION, "VC0706: timing written to %s", VC0706_TIMING_FILE);
+}
+
+/**
+ * Sets the chunk retry budget and what happens to a frame once it's spent (VC0706_SET_RETRY_CC)
+ */
+void VC0706_SetRetry(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetRetryCmd_t)))
+        return;
+
+    VC0706_SetRetryCmd_t *cmd = (VC0706_SetRetryCmd_t *)VC0706MsgPtr;
+    bool policyValid = cmd->Policy == VC0706_RETRY_GIVE_UP || cmd->Policy == VC0706_RETRY_RECAPTURE;
+    if (cmd->Budget > VC0706_MAX_RETRY_BUDGET || !policyValid)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
+                          "VC0706: invalid retry budget %d policy %d, expected 0 - %d and 0 - 1", cmd->Budget, cmd->Policy,
+                          VC0706_MAX_RETRY_BUDGET);
+        return;
+    }
+
+    VC0706_Config.retryBudget = cmd->Budget;
+    VC0706_Config.retryPolicy = cmd->Policy;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: retry budget set to %d chunks, policy %d", cmd->Budget, cmd->Policy);
+}
+
+/**
+ * Sets how long a camera may go unheard before it's probed ahead of a capture (VC0706_SET_PROBE_IDLE_CC)
+ */
+void VC0706_SetProbeIdle(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetProbeIdleCmd_t)))
+        return;
+
+    VC0706_SetProbeIdleCmd_t *cmd = (VC0706_SetProbeIdleCmd_t *)VC0706MsgPtr;
+    VC0706_Config.probeIdleMs = cmd->IdleMs;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION,
+                      "VC0706: probe idle time set to %u ms", (unsigned int)VC0706_Config.probeIdleMs);
+}
+
+/**
+ * Switches thumbnail previews on or off (VC0706_SET_THUMBNAILS_CC)
+ */
+void VC0706_SetThumbnails(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetThumbnailsCmd_t)))
+        return;
+
+    VC0706_SetThumbnailsCmd_t *cmd = (VC0706_SetThumbnailsCmd_t *)VC0706MsgPtr;
+    if (cmd->Enable > 1)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR, "VC0706: invalid thumbnail setting %d, expected 0 or 1", cmd->Enable);
+        return;
+    }
+
+    VC0706_Config.thumbnails = cmd->Enable == 1;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION, "VC0706: thumbnails %s",
+                      VC0706_Config.thumbnails ? "on" : "off");
+}
+
+/**
+ * Sets how many signature cells a frame may change and still be dropped as a repeat (VC0706_SET_DEDUP_CC)
+ */
+void VC0706_SetDedup(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetDedupCmd_t)))
+        return;
+
+    VC0706_SetDedupCmd_t *cmd = (VC0706_SetDedupCmd_t *)VC0706MsgPtr;
+    VC0706_Config.dedupDistance = cmd->Distance;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    if (cmd->Distance == 0)
+        CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION, "VC0706: repeat frame suppression off");
+    else
+        CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION, "VC0706: frames changing %d signature cells or fewer are dropped",
+                          cmd->Distance);
+}
+
+/**
+ * Sets the quota the stored images are kept within (VC0706_SET_STORE_QUOTA_CC). A tighter quota is applied when the
+ * next frame is stored.
+ */
+void VC0706_SetStoreQuota(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetStoreQuotaCmd_t)))
+        return;
+
+    VC0706_SetStoreQuotaCmd_t *cmd = (VC0706_SetStoreQuotaCmd_t *)VC0706MsgPtr;
+    if (cmd->MaxBytes < VC0706_MAX_FRAME_LEN + VC0706_CATALOG_SIDECAR_BYTES || cmd->MaxImages < 1 ||
+        cmd->MaxImages > VC0706_CATALOG_MAX_ENTRIES)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR,
+                          "VC0706: invalid store quota %u bytes %d images, expected at least %u bytes and 1 - %d images",
+                          (unsigned int)cmd->MaxBytes, cmd->MaxImages,
+                          (unsigned int)(VC0706_MAX_FRAME_LEN + VC0706_CATALOG_SIDECAR_BYTES), VC0706_CATALOG_MAX_ENTRIES);
+        return;
+    }
+
+    VC0706_Config.storeQuotaBytes = cmd->MaxBytes;
+    VC0706_Config.storeQuotaImages = cmd->MaxImages;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION, "VC0706: store quota set to %u bytes, %d images",
+                      (unsigned int)cmd->MaxBytes, cmd->MaxImages);
+}
+
+/**
+ * Sets a stored image's downlink status and priority (VC0706_SET_IMAGE_STATUS_CC)
+ */
+void VC0706_SetImageStatus(void)
+{
+    char name[VC0706_MAX_FILENAME_LEN + 1];
+
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetImageStatusCmd_t)))
+        return;
+
+    VC0706_SetImageStatusCmd_t *cmd = (VC0706_SetImageStatusCmd_t *)VC0706MsgPtr;
+    memcpy(name, cmd->ImageName, VC0706_MAX_FILENAME_LEN);
+    name[VC0706_MAX_FILENAME_LEN] = '\0'; // ground may fill the whole field
+    if (cmd->Downlinked > 1 || VC0706_CatalogSetStatus(name, cmd->Downlinked == 1, cmd->Priority) != 0)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR, "VC0706: can't set status of <%s>: no such image or downlinked %d not 0 or 1",
+                          name, cmd->Downlinked);
+        return;
+    }
+
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION, "VC0706: <%s> %s, priority %d", name,
+                      cmd->Downlinked == 1 ? "downlinked" : "not downlinked", cmd->Priority);
+}
+
+/**
+ * Chooses whether frames are stored as a file each or appended to segments (VC0706_SET_STORAGE_FORMAT_CC). Takes
+ * effect from each camera's next frame.
+ */
+void VC0706_SetStorageFormat(void)
+{
+    if (!VC0706_VerifyCmdLength(VC0706MsgPtr, sizeof(VC0706_SetStorageFormatCmd_t)))
+        return;
+
+    VC0706_SetStorageFormatCmd_t *cmd = (VC0706_SetStorageFormatCmd_t *)VC0706MsgPtr;
+    if (cmd->Format != VC0706_FORMAT_FILES && cmd->Format != VC0706_FORMAT_SEGMENTS)
+    {
+        VC0706_HkTelemetryPkt.vc0706_command_error_count++;
+        CFE_EVS_SendEvent(VC0706_COMMAND_ERR_EID, CFE_EVS_ERROR, "VC0706: invalid storage format %d, expected %d or %d",
+                          cmd->Format, VC0706_FORMAT_FILES, VC0706_FORMAT_SEGMENTS);
+        return;
+    }
+
+    VC0706_Config.storageFormat = cmd->Format;
+    VC0706_HkTelemetryPkt.vc0706_command_count++;
+    CFE_EVS_SendEvent(VC0706_COMMANDCFG_INF_EID, CFE_EVS_INFORMATION, "VC0706: frames stored as %s",
+                      cmd->Format == VC0706_FORMAT_SEGMENTS ? "segments" : "files");
+}
+
 /** 
  * Gathers the app's telemetry, packetizes it and sends it to the housekeeping task via the software bus.
  * This function is triggered in response to a task telemetry request from the housekeeping task.
  */
 void VC0706_ReportHousekeeping(void)
 {
+    // Pick up the link state from the cameras
+    int i;
+    uint32 storeBytes;
+    uint16 storeImages;
+    VC0706_HkTelemetryPkt.vc0706_camera_count = VC0706_Config.cameraCount;
+    VC0706_HkTelemetryPkt.vc0706_capture_mode = VC0706_Config.captureMode;
+    VC0706_HkTelemetryPkt.vc0706_motion_window_ms = VC0706_Config.motionWindowMs;
+    VC0706_HkTelemetryPkt.vc0706_motion_sensitivity = VC0706_Config.motionSensitivity;
+    VC0706_HkTelemetryPkt.vc0706_size_target = VC0706_Config.sizeTargetBytes;
+    VC0706_HkTelemetryPkt.vc0706_image_size = VC0706_Config.imageSize;
+    VC0706_HkTelemetryPkt.vc0706_downsize = VC0706_Config.downsize;
+    VC0706_HkTelemetryPkt.vc0706_period_ms = VC0706_Config.periodMs;
+    VC0706_HkTelemetryPkt.vc0706_retry_budget = VC0706_Config.retryBudget;
+    VC0706_HkTelemetryPkt.vc0706_retry_policy = VC0706_Config.retryPolicy;
+    VC0706_HkTelemetryPkt.vc0706_probe_idle_ms = VC0706_Config.probeIdleMs;
+    VC0706_HkTelemetryPkt.vc0706_thumbnails = VC0706_Config.thumbnails;
+    VC0706_HkTelemetryPkt.vc0706_dedup_distance = VC0706_Config.dedupDistance;
+    VC0706_HkTelemetryPkt.vc0706_store_quota_bytes = VC0706_Config.storeQuotaBytes;
+    VC0706_HkTelemetryPkt.vc0706_store_quota_images = VC0706_Config.storeQuotaImages;
+    VC0706_CatalogUsage(&storeBytes, &storeImages);
+    VC0706_HkTelemetryPkt.vc0706_store_bytes = storeBytes;
+    VC0706_HkTelemetryPkt.vc0706_store_images = storeImages;
+    VC0706_HkTelemetryPkt.vc0706_storage_format = VC0706_Config.storageFormat;
+    for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+    {
+        VC0706_HkTelemetryPkt.vc0706_baud[i] = cams[i].baud;
+        memcpy(VC0706_HkTelemetryPkt.vc0706_baud_history[i], cams[i].baudHistory, sizeof(VC0706_HkTelemetryPkt.vc0706_baud_history[i]));
+        VC0706_HkTelemetryPkt.vc0706_baud_fallbacks[i] = cams[i].baudFallbacks;
+        VC0706_HkTelemetryPkt.vc0706_compression[i] = cams[i].compressionApplied;
+        VC0706_HkTelemetryPkt.vc0706_last_frame_len[i] = cams[i].lastFrameLen;
+    }
+
+    for (i = 0; i < VC0706_PHASE_COUNT; i++)
+    {
+        VC0706_TimingStats_t stats;
+        VC0706_TimingSummary((uint8)i, &stats);
+        VC0706_HkTelemetryPkt.vc0706_phase_p50_us[i] = stats.p50Us;
+        VC0706_HkTelemetryPkt.vc0706_phase_p90_us[i] = stats.p90Us;
+        VC0706_HkTelemetryPkt.vc0706_phase_p99_us[i] = stats.p99Us;
+        VC0706_HkTelemetryPkt.vc0706_phase_max_us[i] = stats.maxUs;
+    }
+
+    // Housekeeping is also when a newly loaded capture plan gets activated
+    VC0706_PlanManage();
+
     CFE_SB_TimeStampMsg((CFE_SB_Msg_t *)&VC0706_HkTelemetryPkt);
     CFE_SB_SendMsg((CFE_SB_Msg_t *)&VC0706_HkTelemetryPkt);
+
+    uint64 downloadMs = VC0706_CaptureTlmPkt.vc0706_download_ms;
+    VC0706_CaptureTlmPkt.vc0706_throughput_avg_bps =
+        downloadMs > 0 ? (uint32)(VC0706_CaptureTlmPkt.vc0706_bytes_transferred * 1000 / downloadMs) : 0;
+    CFE_SB_TimeStampMsg((CFE_SB_Msg_t *)&VC0706_CaptureTlmPkt);
+    CFE_SB_SendMsg((CFE_SB_Msg_t *)&VC0706_CaptureTlmPkt);
     return;
 }
 
@@ -163,6 +658,13 @@ void VC0706_ResetCounters(void)
     // Status of commands processed by the VC0706 App
     VC0706_HkTelemetryPkt.vc0706_command_count = 0;
     VC0706_HkTelemetryPkt.vc0706_command_error_count = 0;
+    VC0706_HkTelemetryPkt.vc0706_sync_skew_max_us = 0;
+    VC0706_HkTelemetryPkt.vc0706_trigger_jitter_max_ms = 0;
+    VC0706_HkTelemetryPkt.vc0706_plan_latency_max_ms = 0;
+    VC0706_TimingReset();
+
+    // Everything in the capture packet is a counter
+    memset((uint8 *)&VC0706_CaptureTlmPkt + CFE_SB_TLM_HDR_SIZE, 0, sizeof(VC0706_CaptureTlmPkt) - CFE_SB_TLM_HDR_SIZE);
 
     CFE_EVS_SendEvent(VC0706_COMMANDRST_INF_EID, CFE_EVS_INFORMATION,
                       "VC0706: RESET command");
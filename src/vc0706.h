@@ -39,6 +39,62 @@
 #define LED_PIN 16
 /** Maximum expected filename length /ram/images/<reboots [3 char]>_<cam 0 or 1 [1 char]>_<filenum [3 char]>.jpg */
 #define VC0706_MAX_FILENAME_LEN 24
+/** Most cameras the app can drive, on /dev/ttyAMA0 up to /dev/ttyAMA(n-1) */
+#define VC0706_MAX_CAMERAS 4
+/** Cameras TIM can tell apart, one VC0706_IMAGEn_CMD_CODE each. Camera counts above this are refused until TIM has
+ *  command codes for more. */
+#define VC0706_TIM_CAMERAS 2
+/** Number of cameras driven at startup. Can be changed from the ground with VC0706_SET_CAMERA_COUNT_CC. */
+#define VC0706_DEFAULT_CAMERAS 2
+/** Default motion window in milliseconds */
+#define VC0706_DEFAULT_MOTION_WINDOW_MS 2000
+/** Default number of motion alerts needed within the window to trigger a capture */
+#define VC0706_DEFAULT_MOTION_SENSITIVITY 1
+/** Default frame size budget in bytes for the compression controller */
+#define VC0706_DEFAULT_SIZE_TARGET 15000
+/** Most motion alerts that can be asked for within one window */
+#define VC0706_MAX_MOTION_SENSITIVITY 8
+/** Default capture period in milliseconds for VC0706_MODE_PERIODIC */
+#define VC0706_DEFAULT_PERIOD_MS 10000
+/** Shortest capture period that can be set from the ground */
+#define VC0706_MIN_PERIOD_MS 100
+/** Default number of failed chunks a frame download may re-request */
+#define VC0706_DEFAULT_RETRY_BUDGET 4
+/** Most chunk re-requests that can be allowed per frame */
+#define VC0706_MAX_RETRY_BUDGET 32
+/** Default time in milliseconds a camera may go unheard before it's probed ahead of a capture */
+#define VC0706_DEFAULT_PROBE_IDLE_MS 60000
+/** Most recaptures in a row a camera may ask for under VC0706_RETRY_RECAPTURE, so a dead link can't loop forever */
+#define VC0706_MAX_RECAPTURES 2
+/** Default most bytes the stored images and their sidecar files may take up on the RAM disk */
+#define VC0706_DEFAULT_STORE_QUOTA_BYTES (4 * 1024 * 1024)
+/** Default most images that may be stored */
+#define VC0706_DEFAULT_STORE_QUOTA_IMAGES 200
+/** Number of negotiated baud rates remembered for telemetry */
+#define VC0706_BAUD_HISTORY_LEN 4
+
+/**
+ * Capture settings that can be changed from the ground. Set by the main task, read by the capture task.
+ */
+typedef struct
+{
+    uint8 cameraCount;       /**< Number of cameras to drive */
+    uint8 captureMode;       /**< One of the VC0706_MODE_ values */
+    uint16 motionWindowMs;   /**< Motion alerts older than this many milliseconds no longer count toward a trigger */
+    uint8 motionSensitivity; /**< Motion alerts needed within the window to trigger a capture */
+    uint32 sizeTargetBytes;  /**< Frame size the compression controller aims for, or 0 to leave compression alone */
+    uint8 imageSize;         /**< Camera resolution: SIZE640, SIZE320 or SIZE160 */
+    uint8 downsize;          /**< Camera downsize level: DOWNSIZE_NONE, DOWNSIZE_HALF or DOWNSIZE_QUARTER */
+    uint32 periodMs;         /**< Time between captures in VC0706_MODE_PERIODIC */
+    uint8 retryBudget;       /**< Failed chunks a frame download may re-request before the frame is abandoned */
+    uint8 retryPolicy;       /**< VC0706_RETRY_GIVE_UP or VC0706_RETRY_RECAPTURE */
+    uint32 probeIdleMs;      /**< Time a camera may go unheard before it's probed ahead of a capture, or 0 to always probe */
+    bool thumbnails;         /**< Whether each image gets a thumbnail, announced ahead of it */
+    uint8 dedupDistance;     /**< Most signature cells a frame may change and still be dropped as a repeat, or 0 to keep every frame */
+    uint32 storeQuotaBytes;  /**< Most bytes the stored images and their sidecar files may take up */
+    uint16 storeQuotaImages; /**< Most images that may be stored */
+    uint8 storageFormat;     /**< VC0706_FORMAT_FILES or VC0706_FORMAT_SEGMENTS */
+} VC0706_Config_t;
 
 // This application's component headers
 #include "vc0706_perfids.h"
@@ -56,6 +112,21 @@ void VC0706_ProcessCommandPacket(void);
 void VC0706_ProcessGroundCommand(void);
 void VC0706_ReportHousekeeping(void);
 void VC0706_ResetCounters(void);
+void VC0706_SetCameraCount(void);
+void VC0706_SetCaptureMode(void);
+void VC0706_SetMotionParams(void);
+void VC0706_SetSizeTarget(void);
+void VC0706_SetResolution(void);
+void VC0706_SetPeriod(void);
+void VC0706_Burst(void);
+void VC0706_DumpTiming(void);
+void VC0706_SetRetry(void);
+void VC0706_SetProbeIdle(void);
+void VC0706_SetThumbnails(void);
+void VC0706_SetDedup(void);
+void VC0706_SetStoreQuota(void);
+void VC0706_SetImageStatus(void);
+void VC0706_SetStorageFormat(void);
 
 boolean VC0706_VerifyCmdLength(CFE_SB_MsgPtr_t msg, uint16 ExpectedLength);
 
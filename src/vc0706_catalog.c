@@ -0,0 +1,455 @@
+/**
+ * \file vc0706_catalog.c
+ * \brief Catalog of stored images that keeps the RAM disk within a byte and image count quota
+ *
+ * Every image in VC0706_IMAGE_DIR has an entry here, holding its size (sidecar files included), its age, its priority
+ * and whether ground has confirmed it was downlinked. In segment format each segment has one entry, which grows with
+ * every frame appended to it. Room for a frame is reserved before it's written, using the length the camera reported.
+ * If the frame would take the store over either quota, images are evicted until it fits. Downlinked images go first,
+ * oldest first. Then the lowest priority images go, oldest first within a priority. Because the catalog already knows
+ * every size, making room never scans the directory. A frame that can't be made room for is refused before anything
+ * is written, so the RAM disk never fills up under the storage task.
+ *
+ * The storage task, the thumbnail workers and the main task (for ground commands) all use the catalog, so it's guarded
+ * by a mutex.
+ */
+#include "vc0706_catalog.h"
+#include "vc0706_child.h"
+#include "vc0706_jpeg.h"
+#include "vc0706_segment.h"
+#include "vc0706_thumb.h"
+
+/** The stored images */
+static VC0706_CatalogEntry_t VC0706_Catalog[VC0706_CATALOG_MAX_ENTRIES];
+/** Sequence number for the next image stored */
+static uint32 VC0706_CatalogSeq = 0;
+/** Total size of the stored images and their sidecar files */
+static uint32 VC0706_CatalogBytes = 0;
+/** Number of stored images */
+static uint16 VC0706_CatalogImages = 0;
+/** Guards the catalog */
+static uint32 VC0706_CatalogMutex;
+
+/**
+ * Gets a file's size.
+ * \returns The size in bytes, or 0 if the file doesn't exist
+ */
+static uint32 fileSize(const char *path)
+{
+    os_fstat_t stats;
+    if (OS_stat(path, &stats) != OS_FS_SUCCESS)
+        return 0;
+    return (uint32)stats.st_size;
+}
+
+/**
+ * Recounts the catalog's totals. Call with the mutex held.
+ */
+static void updateUsage(void)
+{
+    int i;
+
+    VC0706_CatalogBytes = 0;
+    VC0706_CatalogImages = 0;
+    for (i = 0; i < VC0706_CATALOG_MAX_ENTRIES; i++)
+    {
+        if (VC0706_Catalog[i].used)
+        {
+            VC0706_CatalogBytes += VC0706_Catalog[i].bytes + VC0706_Catalog[i].held;
+            VC0706_CatalogImages++;
+        }
+    }
+}
+
+/**
+ * Finds an image's entry. Call with the mutex held.
+ * \returns The entry, or NULL if the image isn't in the catalog
+ */
+static VC0706_CatalogEntry_t *findEntry(const char *path)
+{
+    int i;
+    for (i = 0; i < VC0706_CATALOG_MAX_ENTRIES; i++)
+    {
+        if (VC0706_Catalog[i].used && strcmp(VC0706_Catalog[i].path, path) == 0)
+            return &VC0706_Catalog[i];
+    }
+    return NULL;
+}
+
+/**
+ * Checks whether a path names a segment data file rather than a single image.
+ */
+static bool isSegment(const char *path)
+{
+    size_t len = strlen(path);
+    size_t extLen = sizeof(VC0706_SEGMENT_EXT) - 1;
+    return len > extLen && strcmp(path + len - extLen, VC0706_SEGMENT_EXT) == 0;
+}
+
+/**
+ * Deletes an image and its sidecar files, and frees its entry. Call with the mutex held.
+ */
+static void removeEntry(VC0706_CatalogEntry_t *entry)
+{
+    char sidecar[OS_MAX_PATH_LEN];
+    char thumbPath[OS_MAX_PATH_LEN];
+
+    OS_remove(entry->path);
+    snprintf(sidecar, sizeof(sidecar), "%s%s", entry->path, VC0706_CRC_SUFFIX);
+    OS_remove(sidecar);
+    if (VC0706_ThumbPath(entry->path, thumbPath, sizeof(thumbPath)) == 0)
+    {
+        OS_remove(thumbPath);
+        snprintf(sidecar, sizeof(sidecar), "%s%s", thumbPath, VC0706_CRC_SUFFIX);
+        OS_remove(sidecar);
+    }
+    if (isSegment(entry->path) && VC0706_SegmentIndexPath(entry->path, sidecar, sizeof(sidecar)) == 0)
+        OS_remove(sidecar);
+    entry->used = false;
+}
+
+/**
+ * Picks the image to evict next: the oldest downlinked image, or failing that the oldest of the lowest priority.
+ * Images TIM hasn't been told about yet are still in flight and are never picked. Call with the mutex held.
+ * \returns The entry to evict, or NULL if nothing can be
+ */
+static VC0706_CatalogEntry_t *pickVictim(void)
+{
+    VC0706_CatalogEntry_t *victim = NULL;
+    int i;
+
+    for (i = 0; i < VC0706_CATALOG_MAX_ENTRIES; i++)
+    {
+        VC0706_CatalogEntry_t *e = &VC0706_Catalog[i];
+        if (!e->used || !e->announced)
+            continue;
+        if (victim == NULL)
+        {
+            victim = e;
+            continue;
+        }
+        if (e->downlinked != victim->downlinked)
+        {
+            if (e->downlinked)
+                victim = e;
+            continue;
+        }
+        if (!e->downlinked && e->priority != victim->priority)
+        {
+            if (e->priority < victim->priority)
+                victim = e;
+            continue;
+        }
+        if (e->seq < victim->seq)
+            victim = e;
+    }
+    return victim;
+}
+
+/**
+ * Adds a file found in the image directory at startup, with any sidecars it has. Call with the mutex held.
+ */
+static void adoptImage(const char *name)
+{
+    char path[OS_MAX_PATH_LEN];
+    char sidecar[OS_MAX_PATH_LEN];
+    char thumbPath[OS_MAX_PATH_LEN];
+    int i;
+
+    size_t len = strlen(name);
+    if ((len < 4 || strcmp(name + len - 4, ".jpg") != 0) && !isSegment(name))
+        return; // sidecars are counted along with their image or segment
+
+    for (i = 0; i < VC0706_CATALOG_MAX_ENTRIES && VC0706_Catalog[i].used; i++)
+        ;
+    if (i == VC0706_CATALOG_MAX_ENTRIES)
+        return;
+
+    VC0706_CatalogEntry_t *entry = &VC0706_Catalog[i];
+    snprintf(path, sizeof(path), "%s/%s", VC0706_IMAGE_DIR, name);
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+    entry->bytes = fileSize(path);
+    snprintf(sidecar, sizeof(sidecar), "%s%s", path, VC0706_CRC_SUFFIX);
+    entry->bytes += fileSize(sidecar);
+    if (VC0706_ThumbPath(path, thumbPath, sizeof(thumbPath)) == 0)
+    {
+        entry->bytes += fileSize(thumbPath);
+        snprintf(sidecar, sizeof(sidecar), "%s%s", thumbPath, VC0706_CRC_SUFFIX);
+        entry->bytes += fileSize(sidecar);
+    }
+    if (isSegment(path) && VC0706_SegmentIndexPath(path, sidecar, sizeof(sidecar)) == 0)
+        entry->bytes += fileSize(sidecar);
+    entry->seq = VC0706_CatalogSeq++;
+    entry->priority = VC0706_PRIORITY_ROUTINE;
+    entry->announced = true; // by whichever run stored it
+    entry->used = true;
+}
+
+/**
+ * Creates the catalog's mutex and adds whatever images an earlier run left in the image directory, so they count
+ * against the quota. This is the only time the directory is read. Must run before the storage task starts.
+ * \returns OS_SUCCESS, or the OSAL error code
+ */
+int32 VC0706_CatalogInit(void)
+{
+    os_dirent_t *dirent;
+
+    memset(VC0706_Catalog, 0, sizeof(VC0706_Catalog));
+    int32 result = OS_MutSemCreate(&VC0706_CatalogMutex, "VC0706_CATALOG", 0);
+    if (result != OS_SUCCESS)
+        return result;
+
+    os_dirp_t dir = OS_opendir(VC0706_IMAGE_DIR);
+    if (dir != NULL)
+    {
+        while ((dirent = OS_readdir(dir)) != NULL)
+            adoptImage(OS_DIRENTRY_NAME(*dirent));
+        OS_closedir(dir);
+    }
+
+    updateUsage();
+    if (VC0706_CatalogImages > 0)
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_INFORMATION, "Catalog picked up %u stored images (%u bytes)",
+                          (unsigned int)VC0706_CatalogImages, (unsigned int)VC0706_CatalogBytes);
+    return OS_SUCCESS;
+}
+
+/**
+ * Evicts images until the store has room for more. Call with the mutex held and the totals up to date.
+ * \param needed - Bytes to make room for
+ * \param newImages - Entries to make room for
+ * \returns 0 once there's room, -1 if there isn't even with everything evictable gone
+ */
+static int makeRoom(uint32 needed, uint16 newImages)
+{
+    while (VC0706_CatalogImages + newImages > VC0706_Config.storeQuotaImages ||
+           VC0706_CatalogImages + newImages > VC0706_CATALOG_MAX_ENTRIES || VC0706_CatalogBytes + needed > VC0706_Config.storeQuotaBytes)
+    {
+        VC0706_CatalogEntry_t *victim = pickVictim();
+        if (victim == NULL)
+            return -1;
+        VC0706_CatalogBytes -= victim->bytes + victim->held;
+        VC0706_CatalogImages--;
+        removeEntry(victim);
+        VC0706_CaptureTlmPkt.vc0706_images_evicted++;
+    }
+    return 0;
+}
+
+/**
+ * Takes a free entry for a new image. Call with the mutex held, once makeRoom() has made sure there is one.
+ */
+static VC0706_CatalogEntry_t *newEntry(const char *path, uint8 priority)
+{
+    int i;
+
+    for (i = 0; VC0706_Catalog[i].used; i++)
+        ;
+    VC0706_CatalogEntry_t *entry = &VC0706_Catalog[i];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+    entry->seq = VC0706_CatalogSeq++;
+    entry->priority = priority;
+    entry->used = true;
+    return entry;
+}
+
+/**
+ * Makes room for a new image, evicting others if it would take the store over quota, and adds it to the catalog.
+ * Called by the storage task before the image's file is created. Any earlier image at the same path is replaced,
+ * unless TIM hasn't been told about it yet.
+ * \param path - The image's full path
+ * \param bytes - The image's length, as reported by the camera
+ * \param priority - The image's priority
+ * \returns 0 if the image may be stored, -1 if it doesn't fit even with everything evictable gone or its name is
+ *          still in flight
+ */
+int VC0706_CatalogReserve(const char *path, uint32 bytes, uint8 priority)
+{
+    VC0706_CatalogEntry_t *entry;
+    int status = -1;
+
+    OS_MutSemTake(VC0706_CatalogMutex);
+
+    // A reused name overwrites the old image, so its space comes back. One still in flight (a thumbnail worker may be
+    // reading it) is left alone, like pickVictim() does.
+    entry = findEntry(path);
+    bool inFlight = entry != NULL && !entry->announced;
+    if (!inFlight)
+    {
+        if (entry != NULL)
+            removeEntry(entry);
+        updateUsage();
+
+        // The thumbnail's room is held on the entry until it's written, so the store stays within quota meanwhile
+        status = makeRoom(bytes + VC0706_CATALOG_SIDECAR_BYTES, 1);
+        if (status == 0)
+        {
+            entry = newEntry(path, priority);
+            entry->bytes = bytes;
+            entry->held = VC0706_CATALOG_SIDECAR_BYTES;
+            updateUsage();
+        }
+    }
+    if (status != 0)
+        VC0706_CaptureTlmPkt.vc0706_images_refused++;
+    OS_MutSemGive(VC0706_CatalogMutex);
+
+    if (inFlight)
+        CFE_EVS_SendEvent(VC0706_IMAGE_ERR_EID, CFE_EVS_ERROR, "<%s> is still being stored; not replacing it", path);
+    else if (status != 0)
+        CFE_EVS_SendEvent(VC0706_IMAGE_ERR_EID, CFE_EVS_ERROR, "No room for <%s> (%u bytes) within the store quota",
+                          path, (unsigned int)bytes);
+    return status;
+}
+
+/**
+ * Makes room for another frame in a segment, evicting others if it would take the store over quota. The segment is
+ * added to the catalog with its first frame and takes the highest priority of its frames. Called by the storage task
+ * before each frame is appended.
+ * \param path - The segment's data file path
+ * \param bytes - The frame's length plus its index record
+ * \param priority - The frame's priority
+ * \returns 0 if the frame may be stored, -1 if it doesn't fit even with everything evictable gone
+ */
+int VC0706_CatalogExtend(const char *path, uint32 bytes, uint8 priority)
+{
+    OS_MutSemTake(VC0706_CatalogMutex);
+
+    // The open segment isn't announced yet, so it's safe from its own evictions
+    VC0706_CatalogEntry_t *entry = findEntry(path);
+    updateUsage();
+    int status = makeRoom(bytes, entry == NULL ? 1 : 0);
+    if (status == 0)
+    {
+        if (entry == NULL)
+            entry = newEntry(path, priority);
+        entry->bytes += bytes;
+        if (priority > entry->priority)
+            entry->priority = priority;
+        updateUsage();
+    }
+    else
+    {
+        VC0706_CaptureTlmPkt.vc0706_images_refused++;
+    }
+    OS_MutSemGive(VC0706_CatalogMutex);
+
+    if (status != 0)
+        CFE_EVS_SendEvent(VC0706_IMAGE_ERR_EID, CFE_EVS_ERROR, "No room for a %u byte frame in <%s> within the store quota",
+                          (unsigned int)bytes, path);
+    return status;
+}
+
+/**
+ * Checks whether a path is taken by a stored image or segment.
+ */
+bool VC0706_CatalogHas(const char *path)
+{
+    OS_MutSemTake(VC0706_CatalogMutex);
+    bool found = findEntry(path) != NULL;
+    OS_MutSemGive(VC0706_CatalogMutex);
+    return found;
+}
+
+/**
+ * Records an image's size once it and its CRC file are written.
+ * \param path - The image's full path
+ * \param bytes - The size of the image and its CRC file
+ */
+void VC0706_CatalogStored(const char *path, uint32 bytes)
+{
+    OS_MutSemTake(VC0706_CatalogMutex);
+    VC0706_CatalogEntry_t *entry = findEntry(path);
+    if (entry != NULL)
+        entry->bytes = bytes;
+    updateUsage();
+    OS_MutSemGive(VC0706_CatalogMutex);
+}
+
+/**
+ * Adds a thumbnail's size to its image's, in place of the room held for it. Called by the thumbnail workers.
+ * \param path - The image's full path
+ * \param bytes - The size of the sidecar files written
+ */
+void VC0706_CatalogGrow(const char *path, uint32 bytes)
+{
+    OS_MutSemTake(VC0706_CatalogMutex);
+    VC0706_CatalogEntry_t *entry = findEntry(path);
+    if (entry != NULL)
+    {
+        entry->bytes += bytes;
+        entry->held = 0;
+    }
+    updateUsage();
+    OS_MutSemGive(VC0706_CatalogMutex);
+}
+
+/**
+ * Marks an image as announced to TIM, from when on it may be evicted. Any room still held for a thumbnail is given
+ * back, since the thumbnail, if there is one, was announced first.
+ * \param path - The image's full path
+ */
+void VC0706_CatalogAnnounced(const char *path)
+{
+    OS_MutSemTake(VC0706_CatalogMutex);
+    VC0706_CatalogEntry_t *entry = findEntry(path);
+    if (entry != NULL)
+    {
+        entry->announced = true;
+        entry->held = 0;
+    }
+    updateUsage();
+    OS_MutSemGive(VC0706_CatalogMutex);
+}
+
+/**
+ * Forgets an image that was reserved but not kept. The caller deletes the file.
+ * \param path - The image's full path
+ */
+void VC0706_CatalogDrop(const char *path)
+{
+    OS_MutSemTake(VC0706_CatalogMutex);
+    VC0706_CatalogEntry_t *entry = findEntry(path);
+    if (entry != NULL)
+        entry->used = false;
+    updateUsage();
+    OS_MutSemGive(VC0706_CatalogMutex);
+}
+
+/**
+ * Sets an image's downlink status and priority, from VC0706_SET_IMAGE_STATUS_CC.
+ * \param name - The image's name within VC0706_IMAGE_DIR
+ * \param downlinked - Whether ground has the image
+ * \param priority - The image's new priority
+ * \returns 0 on success, -1 if there's no such image
+ */
+int VC0706_CatalogSetStatus(const char *name, bool downlinked, uint8 priority)
+{
+    char path[OS_MAX_PATH_LEN];
+
+    snprintf(path, sizeof(path), "%s/%s", VC0706_IMAGE_DIR, name);
+    OS_MutSemTake(VC0706_CatalogMutex);
+    VC0706_CatalogEntry_t *entry = findEntry(path);
+    if (entry != NULL)
+    {
+        entry->downlinked = downlinked;
+        entry->priority = priority;
+    }
+    OS_MutSemGive(VC0706_CatalogMutex);
+    return entry != NULL ? 0 : -1;
+}
+
+/**
+ * Gets how much the stored images take up, for housekeeping.
+ * \param bytes - Where to put the total size of the images and their sidecar files
+ * \param images - Where to put the number of images
+ */
+void VC0706_CatalogUsage(uint32 *bytes, uint16 *images)
+{
+    OS_MutSemTake(VC0706_CatalogMutex);
+    *bytes = VC0706_CatalogBytes;
+    *images = VC0706_CatalogImages;
+    OS_MutSemGive(VC0706_CatalogMutex);
+}
@@ -0,0 +1,44 @@
+/**
+ * \file vc0706_catalog.h
+ * \brief Header for the catalog of stored images that keeps the RAM disk within its quota
+ */
+#ifndef _vc0706_catalog_h_
+#define _vc0706_catalog_h_
+
+#include "vc0706.h"
+#include "vc0706_thumb.h"
+
+/** Directory the images are stored in */
+#define VC0706_IMAGE_DIR "/ram/images"
+/** Most images the catalog can track. Also the largest image count quota that can be set. */
+#define VC0706_CATALOG_MAX_ENTRIES 256
+/** Room kept beside each image for its CRC file, thumbnail and thumbnail CRC file */
+#define VC0706_CATALOG_SIDECAR_BYTES (VC0706_THUMB_MAX_DIM * VC0706_THUMB_MAX_DIM + 64)
+
+/**
+ * A stored image, along with its sidecar files
+ */
+typedef struct
+{
+    char path[OS_MAX_PATH_LEN]; /**< The image's full path */
+    uint32 bytes;               /**< Size of the image and its sidecar files */
+    uint32 held;                /**< Room still held for a thumbnail not written yet, counted against the quota */
+    uint32 seq;                 /**< Order the image was stored in; lower is older */
+    uint8 priority;             /**< One of the VC0706_PRIORITY_ values, or a ground-set level. Higher is kept longer. */
+    bool downlinked;            /**< Whether ground has confirmed it has the image */
+    bool announced;             /**< Whether TIM has been told about the image. Unannounced images are never evicted. */
+    bool used;                  /**< Whether this entry holds an image */
+} VC0706_CatalogEntry_t;
+
+int32 VC0706_CatalogInit(void);
+int VC0706_CatalogReserve(const char *path, uint32 bytes, uint8 priority);
+int VC0706_CatalogExtend(const char *path, uint32 bytes, uint8 priority);
+bool VC0706_CatalogHas(const char *path);
+void VC0706_CatalogStored(const char *path, uint32 bytes);
+void VC0706_CatalogGrow(const char *path, uint32 bytes);
+void VC0706_CatalogAnnounced(const char *path);
+void VC0706_CatalogDrop(const char *path);
+int VC0706_CatalogSetStatus(const char *name, bool downlinked, uint8 priority);
+void VC0706_CatalogUsage(uint32 *bytes, uint16 *images);
+
+#endif
@@ -3,10 +3,11 @@
  * \brief The child task spawned by the VC0706 app to take pictures
  */
 #include "vc0706_child.h"
+#include "vc0706_catalog.h"
 #include "vc0706_device.h"
-
-// Command packet from vc0706.c
-extern VC0706_IMAGE_CMD_PKT_t VC0706_ImageCmdPkt;
+#include "vc0706_sched.h"
+#include "vc0706_storage.h"
+#include "vc0706_thumb.h"
 
 char *taskName = "VC0706 Child Task"; /**< Name under which to register this task */
 
@@ -23,6 +24,22 @@ int VC0706_ChildInit(void)
     // Read number of reboots
     VC0706_setNumReboots();
 
+    // The catalog must know what's already stored before the storage task adds to it
+    if (VC0706_CatalogInit() != OS_SUCCESS)
+        return -1;
+
+    // Start the storage task first so it's ready to take images from the capture task
+    if (VC0706_StorageInit() != CFE_SUCCESS)
+        return -1;
+
+    // Thumbnail workers take images from the storage task when previews are switched on
+    if (VC0706_ThumbInit() != CFE_SUCCESS)
+        return -1;
+
+    // The main task forwards scheduler wakeups and bursts to the capture task through the trigger queue
+    if (VC0706_SchedInit() != OS_SUCCESS)
+        return -1;
+
     // Create child task - VC0706 monitor task
     int32 result = CFE_ES_CreateChildTask(&VC0706_ChildTaskID,
                                           VC0706_CHILD_TASK_NAME,
@@ -76,10 +93,15 @@ void VC0706_ChildTask(void)
 
 /** 
  * Sends the filename of a saved picture to TIM.
+ * Called from both the capture and storage tasks, so the packet is built on the caller's stack.
+ * \param file_name - The image's name within /ram/images/
+ * \param crc - The image's CRC32, so TIM can check it without reading the file back
  * \returns At the moment, 0.
  */
-int VC0706_SendTimFileName(char *file_name)
+int VC0706_SendTimFileName(char *file_name, uint32 crc)
 {
+    VC0706_IMAGE_CMD_PKT_t VC0706_ImageCmdPkt;
+
     // Initialize a Software Bus message using our packet templates for this app
     CFE_SB_InitMsg((void *)&VC0706_ImageCmdPkt, (CFE_SB_MsgId_t)VC0706_IMAGE_CMD_MID, (uint16)VC0706_IMAGE_CMD_LNGTH, (boolean)1);
 
@@ -106,10 +128,13 @@ int VC0706_SendTimFileName(char *file_name)
     }
 
     snprintf(VC0706_ImageCmdPkt.ImageName, sizeof(VC0706_ImageCmdPkt.ImageName), "%s", file_name);
+    VC0706_ImageCmdPkt.ImageCrc = crc;
 
     CFE_SB_GenerateChecksum((CFE_SB_MsgPtr_t)&VC0706_ImageCmdPkt);
 
+    CFE_ES_PerfLogEntry(VC0706_NOTIFY_PERF_ID);
     CFE_SB_SendMsg((CFE_SB_Msg_t *)&VC0706_ImageCmdPkt);
+    CFE_ES_PerfLogExit(VC0706_NOTIFY_PERF_ID);
 
     CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_INFORMATION, "Message sent to TIM from VC0706.");
 
@@ -13,10 +13,12 @@
 //TODO: Check necessity of each of these to trim fat
 
 extern vc0706_hk_tlm_t VC0706_HkTelemetryPkt;
+extern vc0706_capture_tlm_t VC0706_CaptureTlmPkt;
 extern uint32 VC0706_ChildTaskID;
+extern VC0706_Config_t VC0706_Config;
 
 int VC0706_ChildInit(void);
 void VC0706_ChildTask(void);
-int VC0706_SendTimFileName(char *file_name);
+int VC0706_SendTimFileName(char *file_name, uint32 crc);
 
 #endif
\ No newline at end of file
@@ -8,9 +8,30 @@
  */
 
 #include "vc0706_core.h"
+#include "vc0706_parser.h"
+#include "vc0706_serial.h"
+#include "vc0706_storage.h"
+#include "vc0706_child.h"
 
 extern struct led_t led; /**< LED instance from vc0706.c */
 
+/**
+ * A baud rate the VC0706 can be switched to, along with its SET_PORT divider code
+ */
+typedef struct
+{
+    uint32 baud;   /**< The rate in bits per second */
+    uint8_t hi;    /**< High byte of the camera's divider code */
+    uint8_t lo;    /**< Low byte of the camera's divider code */
+} BaudRate_t;
+
+/** Rates to try during negotiation, fastest first. The last entry must be the power-on rate (BAUD). */
+static const BaudRate_t baudRates[] = {
+    {115200, 0x0D, 0xA6},
+    {57600, 0x1C, 0x4C},
+    {38400, 0x2A, 0xF2},
+};
+
 /**
  * Initializes the cameras' serial interfaces.
  * \param[in,out] cam - A pointer to the Camera structure to initialize
@@ -18,11 +39,10 @@ extern struct led_t led; /**< LED instance from vc0706.c */
  */
 int init(Camera_t *cam, uint8 ttyInterface)
 {
-    // Initialize fdPath to the length of "/dev/ttyAMA0" (plus string terminator obviously)
-    char fdPath[13];
+    char fdPath[OS_MAX_PATH_LEN];
 
     // Create the file path for the TTY interface from a format string and the ttyInterface parameter
-    snprintf(fdPath, 13, "/dev/ttyAMA%d", ttyInterface);
+    snprintf(fdPath, sizeof(fdPath), VC0706_TTY_PATH_FMT, ttyInterface);
 
     // Set ttyInterface attribute on Camera
     cam->ttyInterface = ttyInterface;
@@ -31,13 +51,27 @@ int init(Camera_t *cam, uint8 ttyInterface)
     cam->frameptr = 0;
     cam->bufferLen = 0;
     cam->serialNum = 0;
+    cam->bytesPerSec = 0;
+    cam->ringHead = 0;
+    rxReset(&cam->rx);
+    cam->rx.motionAlerts = 0;
+    cam->baud = BAUD;
+    memset(cam->baudHistory, 0, sizeof(cam->baudHistory));
+    cam->baudFallbacks = 0;
+    cam->compression = VC0706_DEFAULT_COMPRESSION;
+    cam->compressionApplied = VC0706_DEFAULT_COMPRESSION;
+    cam->lastFrameLen = 0;
+    cam->imageSize = SIZE640;
+    cam->imageSizeApplied = SIZE_UNKNOWN;
+    cam->downsize = DOWNSIZE_NONE;
+    cam->downsizeApplied = DOWNSIZE_NONE;
     cam->motion = 1;
     cam->ready = false;
 
     // Open serial device, send error message as CFE event if it fails (returns code other than 0)
     if ((cam->fd = serialOpen(fdPath, BAUD)) < 0)
     {
-        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "init Error: Failed to open specified port at %s. STDERR: %s", "/dev/ttyAMA0", strerror(errno));
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "init Error: Failed to open specified port at %s. STDERR: %s", fdPath, strerror(errno));
         return -1;
     }
 
@@ -51,57 +85,213 @@ int init(Camera_t *cam, uint8 ttyInterface)
 
     // Once the serial interface and WiringPi have been initialized, the camera is ready.
     cam->ready = true;
+
+    // Move the link up to the fastest rate the camera will hold
+    negotiateBaud(cam);
+
+    // The size lives in EEPROM, so the camera comes up at whatever was last written there
+    cam->imageSizeApplied = readImageSize(cam);
+    cam->imageSize = cam->imageSizeApplied;
     return 0;
 }
 
 /**
- * Reads data from a connected camera.
+ * Reopens the camera's serial port at a new rate. Does not talk to the camera.
+ * \param[in,out] cam - A pointer to the Camera whose port should be reopened
+ * \param baud - The rate to open the port at
+ * \returns 0 on success, -1 if the port could not be reopened
+ */
+static int reopenPort(Camera_t *cam, uint32 baud)
+{
+    char fdPath[OS_MAX_PATH_LEN];
+    snprintf(fdPath, sizeof(fdPath), VC0706_TTY_PATH_FMT, cam->ttyInterface);
+
+    serialClose(cam->fd);
+    if ((cam->fd = serialOpen(fdPath, (int)baud)) < 0)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "Camera %d failed to reopen %s at %u baud. STDERR: %s",
+                          cam->ttyInterface, fdPath, baud, strerror(errno));
+        cam->ready = false;
+        return -1;
+    }
+    cam->baud = baud;
+    return 0;
+}
+
+/**
+ * Switches both the camera and our end of the link to a new baud rate.
+ * \param[in,out] cam - A pointer to the Camera to reconfigure
+ * \param baud - The new rate. Must be one of the rates in baudRates[].
+ * \returns 0 if the camera acknowledged the change and answers a version query at the new rate, -1 otherwise
+ */
+int setBaud(Camera_t *cam, uint32 baud)
+{
+    const BaudRate_t *rate = NULL;
+    size_t i;
+    for (i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++)
+    {
+        if (baudRates[i].baud == baud)
+            rate = &baudRates[i];
+    }
+    if (rate == NULL)
+        return -1;
+
+    // SET_PORT: interface type 1 (UART) followed by the divider code
+    uint8_t setPortArgs[] = {0x03, 0x01, rate->hi, rate->lo};
+    sendCommand(cam, SET_PORT, setPortArgs, sizeof(setPortArgs));
+
+    // The acknowledgement still comes back at the old rate
+    if (!checkReply(cam, SET_PORT, 5))
+        return -1;
+
+    // Give the camera's UART a moment to switch over, then follow it
+    OS_TaskDelay(10);
+    if (reopenPort(cam, baud) == -1)
+        return -1;
+    clearBuffer(cam);
+
+    return getVersion(cam);
+}
+
+/**
+ * Raises the serial link to the fastest rate that passes a version check, falling back to slower rates on failure.
+ * Expects the camera to be at BAUD, as it is after power-on or reset.
+ * \param[in,out] cam - A pointer to the Camera to negotiate with
+ * \returns The rate the link settled on
+ */
+uint32 negotiateBaud(Camera_t *cam)
+{
+    const size_t rateCount = sizeof(baudRates) / sizeof(baudRates[0]);
+    size_t i;
+    for (i = 0; i < rateCount - 1; i++)
+    {
+        if (setBaud(cam, baudRates[i].baud) == 0)
+            break;
+
+        // The camera may or may not have switched. Ask it to go back to the default at both rates, then
+        // bring our end back down to the default too.
+        cam->baudFallbacks++;
+        uint8_t setPortArgs[] = {0x03, 0x01, baudRates[rateCount - 1].hi, baudRates[rateCount - 1].lo};
+        sendCommand(cam, SET_PORT, setPortArgs, sizeof(setPortArgs));
+        OS_TaskDelay(10);
+        if (reopenPort(cam, BAUD) == -1)
+            return 0;
+        sendCommand(cam, SET_PORT, setPortArgs, sizeof(setPortArgs));
+        OS_TaskDelay(10);
+        clearBuffer(cam);
+
+        CFE_EVS_SendEvent(VC0706_REPLY_ERR_EID, CFE_EVS_ERROR, "Camera %d failed link check at %u baud, falling back",
+                          cam->ttyInterface, baudRates[i].baud);
+    }
+
+    // Record the outcome, newest first
+    memmove(&cam->baudHistory[1], &cam->baudHistory[0], sizeof(cam->baudHistory) - sizeof(cam->baudHistory[0]));
+    cam->baudHistory[0] = cam->baud;
+
+    CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_INFORMATION, "Camera %d link running at %u baud",
+                      cam->ttyInterface, cam->baud);
+    return cam->baud;
+}
+
+/**
+ * Gives the time a number of bytes takes on the wire at the camera's current rate, plus the reply allowance.
+ * \param cam - A pointer to the Camera whose link rate to use
+ * \param bytes - The number of bytes expected
+ * \returns A deadline in milliseconds suitable for reading that many bytes
+ */
+uint32 wireTimeMs(Camera_t *cam, uint32 bytes)
+{
+    // 10 bits per byte on the wire (start + 8 data + stop)
+    return VC0706_REPLY_TIMEOUT_MS + (uint32)((uint64_t)bytes * 10 * 1000 / cam->baud);
+}
+
+/**
+ * Reads up to len bytes from the camera into buf, blocking in poll() until they arrive or the deadline passes. Bytes
+ * already received along with an earlier reply are used first.
+ * \param cam - A pointer to the Camera to read from
+ * \param[out] buf - The buffer to read into. Must hold at least len bytes.
+ * \param len - The number of bytes wanted
+ * \param timeoutMs - The deadline for the whole read, in milliseconds
+ * \returns The number of bytes actually read, which is less than len if the camera stopped sending
+ */
+int readBytes(Camera_t *cam, uint8_t *buf, int len, uint32 timeoutMs)
+{
+    int length = (int)rxTake(&cam->rx, buf, (uint32)len);
+    if (length < len)
+        length += pollRead(cam->fd, buf + length, len - length, timeoutMs);
+    return length;
+}
+
+/**
+ * Reads a reply from a connected camera.
  * \param cam - A pointer to the Camera representing the camera to read from.
- * \param size - The maximum message size to read.
- * \param readTimeout - The maximum attempts between successful reads
+ * \param[out] reply - The buffer to read the reply into
+ * \param size - The maximum message size to read. Capped at CAMERABUFFSIZ.
+ * \param timeoutMs - The deadline for the whole reply, in milliseconds
+ * \returns The number of bytes read into reply
  */
-char *readCamera(Camera_t *cam, int size, const int readTimeout)
+int readCamera(Camera_t *cam, uint8_t *reply, int size, uint32 timeoutMs)
 {
-    char reply[size];  /**< Buffer to read the camera's reply into */
-    int try_count = 0; /**< Failed read attempt count. Used to drop out of loop if camera fails. */
-    int length = 0;    /**< Length of the reply that has been received so far */
+    if (size > CAMERABUFFSIZ)
+        size = CAMERABUFFSIZ;
+    return readBytes(cam, reply, size, timeoutMs);
+}
 
-    // While communication hasn't timed out, the data received is less than the buffer size and requested size..
-    while ((readTimeout < try_count) && (length < CAMERABUFFSIZ) && length < size)
+/**
+ * Counts a reply that went wrong in the capture telemetry, against the command it answered.
+ * \param cmd - The command code the reply was for
+ * \param timedOut - true if the reply didn't arrive in time, false if it arrived malformed
+ */
+void countReplyFailure(uint8 cmd, bool timedOut)
+{
+    uint8 index;
+    switch (cmd)
     {
-        // If a byte is not waiting to be read on the serial interface
-        if (serialDataAvail(cam->fd) <= 0)
-        {
-            // Sleep for however long is defined in vc0706_core.h
-            usleep(TO_U);
-            try_count++;
-        }
-        else
-        {
-            // There's a byte! Read it into reply[].
-            reply[length++] = (char)serialGetchar(cam->fd);
-            // Reset timeout between received characters
-            try_count = 0;
-        }
+    case WRITE_DATA: index = VC0706_CMDSTAT_WRITE_DATA; break;
+    case DOWNSIZE_CTRL: index = VC0706_CMDSTAT_DOWNSIZE; break;
+    case GEN_VERSION: index = VC0706_CMDSTAT_VERSION; break;
+    case FBUF_CTRL: index = VC0706_CMDSTAT_FBUF_CTRL; break;
+    case GET_FBUF_LEN: index = VC0706_CMDSTAT_FBUF_LEN; break;
+    case READ_FBUF: index = VC0706_CMDSTAT_READ_FBUF; break;
+    case SET_PORT: index = VC0706_CMDSTAT_SET_PORT; break;
+    case RESET: index = VC0706_CMDSTAT_RESET; break;
+    default: index = VC0706_CMDSTAT_OTHER; break;
     }
-    return reply;
+
+    if (timedOut)
+        VC0706_CaptureTlmPkt.vc0706_reply_timeouts[index]++;
+    else
+        VC0706_CaptureTlmPkt.vc0706_reply_errors[index]++;
 }
 
 /**
- * Ensure that the camera has responded properly to a specified command.
+ * Ensure that the camera has responded properly to a specified command. Noise and stale bytes ahead of the reply are
+ * skipped, and motion alerts that arrive first are kept for the motion trigger.
  * \param cam - A pointer to the Camera to check
  * \param cmd - The command previously issued (which we are looking for a response to)
  * \param size - The size of the response the camera SHOULD reply with
  */
 bool checkReply(Camera_t *cam, int cmd, int size)
 {
-    // Timeout between serial reads. TO_SCALE is a setting in vc0706_core.h to modify all timeouts at once.
-    int timeout = 3 * TO_SCALE;
-    char *reply = readCamera(cam, size, timeout);
-    // Check if the reply is valid
-    bool replyValidity = reply[0] == COMMAND_SUCCESS && reply[1] == cam->serialNum && reply[2] == cmd;
+    VC0706_Reply_t expect = {(uint8)cmd, cam->serialNum, 0, false};
+    uint8_t reply[VC0706_REPLY_HEADER_LEN] = {0};
+    uint64_t deadline = monotonicMs() + wireTimeMs(cam, (uint32)size);
+    uint8 result;
+
+    // Frame the reply out of whatever has arrived, reading more until it completes or the deadline passes
+    while ((result = rxNextReply(&cam->rx, &expect, reply)) == VC0706_PARSE_MORE)
+    {
+        uint64_t now = monotonicMs();
+        if (now >= deadline || waitReadable(cam->fd, (uint32)(deadline - now)) <= 0 || rxFill(&cam->rx, cam->fd) < 0)
+            break;
+    }
+
+    bool replyValidity = result == VC0706_PARSE_REPLY;
     if (!replyValidity)
+    {
+        countReplyFailure((uint8)cmd, result == VC0706_PARSE_MORE);
         CFE_EVS_SendEvent(VC0706_REPLY_ERR_EID, CFE_EVS_ERROR, "Camera %d unresponsive! R[0] = [%x] R[1] = [%x] R[2] = [%x]", cam->ttyInterface, reply[0], reply[1], reply[2]);
+    }
     // Return the reply's validity as the execution status of this function
     return replyValidity;
 }
@@ -112,13 +302,10 @@ bool checkReply(Camera_t *cam, int cmd, int size)
  */
 void clearBuffer(Camera_t *cam)
 {
-    int bytesCleared;
-    for (bytesCleared = 0; bytesCleared < CAMERABUFFSIZ; bytesCleared++)
-    {
-        // If there's a byte available, read it, but don't store it anywhere.
-        if (serialDataAvail(cam->fd) > 0)
-            serialGetchar(cam->fd);
-    }
+    rxReset(&cam->rx);
+
+    // Discard until the line goes quiet, rather than sampling it a fixed number of times
+    pollDrain(cam->fd, VC0706_DRAIN_QUIET_MS, VC0706_DRAIN_MAX_MS);
 }
 
 /**
@@ -133,7 +320,18 @@ void reset(Camera_t *cam)
 
     if (!checkReply(cam, RESET, 5))
         OS_printf("reset() Check Reply Status: %s\n", strerror(errno));
+
+    // The camera comes back up at its default rate, compression and downsize level, so follow it down and then bring
+    // the link back up. The capture engine re-applies the wanted settings before the next frame. The size is kept in
+    // EEPROM and survives the reset, so it's read back rather than assumed.
+    cam->compressionApplied = VC0706_DEFAULT_COMPRESSION;
+    cam->downsizeApplied = DOWNSIZE_NONE;
+    OS_TaskDelay(VC0706_RESET_DELAY_MS);
+    if (cam->baud != BAUD && reopenPort(cam, BAUD) == -1)
+        return;
     clearBuffer(cam);
+    negotiateBaud(cam);
+    cam->imageSizeApplied = readImageSize(cam);
 }
 
 /**
@@ -144,9 +342,12 @@ void resumeVideo(Camera_t *cam)
 {
     // Use frame buffer control (FBUF_CTRL) to resume video on the camera
     uint8_t frameBufferControlArgs[] = {0x01, RESUMEFRAME};
+    CFE_ES_PerfLogEntry(VC0706_RESUME_PERF_ID);
     sendCommand(cam, FBUF_CTRL, frameBufferControlArgs, sizeof(frameBufferControlArgs));
 
-    if (!checkReply(cam, FBUF_CTRL, 5))
+    bool resumed = checkReply(cam, FBUF_CTRL, 5);
+    CFE_ES_PerfLogExit(VC0706_RESUME_PERF_ID);
+    if (!resumed)
         OS_printf("Camera did not resume\n");
 }
 
@@ -158,15 +359,21 @@ int getVersion(Camera_t *cam)
 {
     // Check the version of the camera
     uint8_t genVersionArgs[] = {0x00};
+    CFE_ES_PerfLogEntry(VC0706_VERSION_PERF_ID);
     sendCommand(cam, GEN_VERSION, genVersionArgs, sizeof(genVersionArgs));
 
     if (!checkReply(cam, GEN_VERSION, 5))
     {
         //OS_printf("CAMERA NOT FOUND!!!\n");
+        CFE_ES_PerfLogExit(VC0706_VERSION_PERF_ID);
         return -1;
     }
     else
     {
+        // Consume the version string ("VC0703 1.00") so it isn't mistaken for the next reply
+        uint8_t version[11];
+        readCamera(cam, version, sizeof(version), wireTimeMs(cam, sizeof(version)));
+        CFE_ES_PerfLogExit(VC0706_VERSION_PERF_ID);
         return 0;
     }
 }
@@ -192,165 +399,427 @@ void setMotionDetect(Camera_t *cam, bool flag)
 }
 
 /**
- * Sends a command over serial to the specified camera.
- * \param cam - A pointer to the camera to command
- * \param cmd - The type of command to send
- * \param args - An array of the codes to write to the interface
- * \param argLen - The length of the array
+ * Builds the WRITE_DATA arguments that set the camera's JPEG compression ratio register.
+ * \param[out] args - Filled with the six WRITE_DATA argument bytes
+ * \param ratio - The compression ratio. Higher values give smaller, lower quality frames.
  */
-void sendCommand(Camera_t *cam, uint8_t cmd, uint8_t args[], uint8_t argLen)
+void compressionArgs(uint8_t args[6], uint8 ratio)
 {
-    serialPutchar(cam->fd, (char)COMMAND_BEGIN);
-    serialPutchar(cam->fd, (char)cam->serialNum);
-    serialPutchar(cam->fd, (char)cmd);
-    uint8_t i;
-    for (i = 0; i < argLen; i++)
-    {
-        serialPutchar(cam->fd, (char)args[i]);
-    }
+    args[0] = 0x05; // Argument length
+    args[1] = 0x01; // Register type: chip register
+    args[2] = 0x01; // Data length
+    args[3] = 0x12; // Address of the compression ratio register
+    args[4] = 0x04;
+    args[5] = ratio;
 }
 
 /**
- * Takes a picture and writes it to disk.
- * \param[in,out] cam - A pointer to the camera to take a picture with
- * \param file_path - The name of the file to save to
+ * Builds the WRITE_DATA arguments that set the camera's output resolution. The size register is in the camera's
+ * EEPROM: it survives power cycles and only takes effect after a reset (see setImageSize()).
+ * \param[out] args - Filled with the six WRITE_DATA argument bytes
+ * \param size - SIZE640, SIZE320 or SIZE160
  */
-char *takePicture(Camera_t *cam, char *file_path)
+void imageSizeArgs(uint8_t args[6], uint8 size)
 {
-    // Reset the frame pointer
-    cam->frameptr = 0;
-    // Enable LED
-    led_on(&led);     // initialized in vc0706_device.c
-    OS_TaskDelay(50); // wait one 1ms to allow the LED to heat up
+    args[0] = 0x05; // Argument length
+    args[1] = 0x04; // Register type: I2C EEPROM
+    args[2] = 0x01; // Data length
+    args[3] = 0x00; // Address of the image size register
+    args[4] = 0x19;
+    args[5] = size;
+}
 
-    // Clear Buffer
-    clearBuffer(cam);
+/**
+ * Reads the image size held in the camera's EEPROM (READ_DATA), which is the size it takes frames at.
+ * \param cam - A pointer to the Camera to query
+ * \returns SIZE640, SIZE320 or SIZE160, or SIZE_UNKNOWN if the camera didn't answer
+ */
+uint8 readImageSize(Camera_t *cam)
+{
+    uint8_t readDataArgs[] = {0x04, 0x04, 0x01, 0x00, 0x19};
+    uint8_t size;
+
+    sendCommand(cam, READ_DATA, readDataArgs, sizeof(readDataArgs));
+    if (!checkReply(cam, READ_DATA, 5))
+        return SIZE_UNKNOWN;
+    if (readCamera(cam, &size, 1, wireTimeMs(cam, 1)) != 1)
+        return SIZE_UNKNOWN;
+    return size;
+}
 
-    // Tell the camera to hold the current frame (holds it in memory on the camera board so we can retrieve it)
-    uint8_t frameBufferControlArgs[] = {0x01, STOPCURRENTFRAME};
-    sendCommand(cam, FBUF_CTRL, frameBufferControlArgs, sizeof(frameBufferControlArgs));
+/**
+ * Changes the camera's resolution. The size is written to EEPROM, then the camera is reset so it takes effect and the
+ * link is renegotiated. Blocks for the length of the reset.
+ * \param[in,out] cam - A pointer to the Camera to change
+ * \param size - SIZE640, SIZE320 or SIZE160
+ * \returns 0 if the camera reads back the new size, -1 otherwise
+ */
+int setImageSize(Camera_t *cam, uint8 size)
+{
+    uint8_t writeDataArgs[6];
 
-    // Disable LED
-    led_off(&led);
+    imageSizeArgs(writeDataArgs, size);
+    sendCommand(cam, WRITE_DATA, writeDataArgs, sizeof(writeDataArgs));
+    if (!checkReply(cam, WRITE_DATA, 5))
+        return -1;
 
-    if (!checkReply(cam, FBUF_CTRL, 5))
+    reset(cam);
+    if (cam->imageSizeApplied != size)
     {
-        OS_printf("Frame checkReply Failed\n");
-        return "";
+        CFE_EVS_SendEvent(VC0706_REPLY_ERR_EID, CFE_EVS_ERROR, "Camera %d reads back size 0x%02x after setting 0x%02x",
+                          cam->ttyInterface, cam->imageSizeApplied, size);
+        return -1;
     }
+    return 0;
+}
 
-    uint8_t getFrameBufferLengthArgs[] = {0x01, 0x00};
-    sendCommand(cam, GET_FBUF_LEN, getFrameBufferLengthArgs, sizeof(getFrameBufferLengthArgs));
+/**
+ * Closed-loop frame size control. Nudges the compression ratio for the next frame so frames land near a byte budget.
+ * The step is proportional to how far the last frame missed the target, with a deadband and a cap on each change.
+ * \param[in,out] cam - The camera whose frame was just downloaded
+ * \param frameLen - The length of that frame
+ * \param targetBytes - The byte budget per frame, or 0 to leave compression alone
+ */
+void adjustCompression(Camera_t *cam, uint32 frameLen, uint32 targetBytes)
+{
+    cam->lastFrameLen = frameLen;
+    if (targetBytes == 0)
+        return;
+
+    int32 errorPct = (int32)(((int64_t)frameLen - (int64_t)targetBytes) * 100 / (int64_t)targetBytes);
+    if (errorPct <= VC0706_SIZE_TOLERANCE_PCT && errorPct >= -VC0706_SIZE_TOLERANCE_PCT)
+        return;
+
+    // Too big means more compression, too small means less
+    int32 step = errorPct * VC0706_COMPRESSION_GAIN_NUM / VC0706_COMPRESSION_GAIN_DEN;
+    if (step > VC0706_COMPRESSION_MAX_STEP)
+        step = VC0706_COMPRESSION_MAX_STEP;
+    if (step < -VC0706_COMPRESSION_MAX_STEP)
+        step = -VC0706_COMPRESSION_MAX_STEP;
+    if (step == 0)
+        step = errorPct > 0 ? 1 : -1;
+
+    int32 ratio = (int32)cam->compression + step;
+    if (ratio < VC0706_MIN_COMPRESSION)
+        ratio = VC0706_MIN_COMPRESSION;
+    if (ratio > VC0706_MAX_COMPRESSION)
+        ratio = VC0706_MAX_COMPRESSION;
+    cam->compression = (uint8)ratio;
+}
 
-    if (!checkReply(cam, GET_FBUF_LEN, 5))
+/**
+ * The layout of a command and its reply
+ */
+typedef struct
+{
+    uint8 cmd;       /**< The command code */
+    uint8 minArgs;   /**< Fewest argument bytes the command takes, counting the leading length byte */
+    uint8 replyData; /**< Bytes of data after the reply header, or VC0706_REPLY_DATA_VARIABLE */
+    bool tail;       /**< Whether a second reply frame follows the data */
+} CommandSpec_t;
+
+/** Every command in vc0706_core.h, with the shape of its reply */
+static const CommandSpec_t commandSpecs[] = {
+    {RESET, 1, 0, false},
+    {GEN_VERSION, 1, VC0706_VERSION_LEN, false},
+    {SET_PORT, 4, 0, false},
+    {READ_DATA, 5, VC0706_REPLY_DATA_VARIABLE, false},
+    {WRITE_DATA, 6, 0, false},
+    {READ_FBUF, 13, 0, true},
+    {GET_FBUF_LEN, 2, 4, false},
+    {FBUF_CTRL, 2, 0, false},
+    {COMM_MOTION_CTRL, 2, 0, false},
+    {COMM_MOTION_STATUS, 1, 1, false},
+    {MOTION_CTRL, 4, 0, false},
+    {MOTION_STATUS, 2, VC0706_REPLY_DATA_VARIABLE, false},
+    {TVOUT_CTRL, 2, 0, false},
+    {OSD_ADD_CHAR, 3, 0, false},
+    {DOWNSIZE_CTRL, 2, 0, false},
+    {DOWNSIZE_STATUS, 1, 1, false},
+    {SET_ZOOM, 1, 0, false},
+    {GET_ZOOM, 1, VC0706_REPLY_DATA_VARIABLE, false},
+};
+
+/**
+ * Sends a command over serial to the specified camera. The whole frame is built on the stack and sent with one write.
+ * \param cam - A pointer to the camera to command
+ * \param cmd - The type of command to send
+ * \param args - The command's arguments, starting with their length byte
+ * \param argLen - The length of the array
+ * \returns The reply to expect. Its cmd is 0 if the command is malformed or could not be written.
+ */
+VC0706_Reply_t sendCommand(Camera_t *cam, uint8_t cmd, const uint8_t args[], uint8_t argLen)
+{
+    VC0706_Reply_t expect = {0, cam->serialNum, VC0706_REPLY_DATA_VARIABLE, false};
+    const CommandSpec_t *spec = NULL;
+    uint8_t frame[VC0706_MAX_COMMAND_LEN];
+    size_t i;
+
+    for (i = 0; i < sizeof(commandSpecs) / sizeof(commandSpecs[0]); i++)
     {
-        OS_printf("FBUF_LEN REPLY NOT VALID!!!\n");
-        return "";
+        if (commandSpecs[i].cmd == cmd)
+            spec = &commandSpecs[i];
     }
 
-    // Wait for picture data to be available for reading
-    while (serialDataAvail(cam->fd) <= 0);
-
-    // Retrieve the image's length from the camera
-    unsigned int len;
-    len = serialGetchar(cam->fd);
-    len <<= 8;
-    len |= serialGetchar(cam->fd);
-    len <<= 8;
-    len |= serialGetchar(cam->fd);
-    len <<= 8;
-    len |= serialGetchar(cam->fd);
-
-    // If the image is too large, reset the camera and run this function again
-    if (len > 20000)
+    // The first argument byte counts the ones after it
+    if (spec == NULL || argLen < spec->minArgs || argLen + 3 > VC0706_MAX_COMMAND_LEN || args[0] != argLen - 1)
     {
-        CFE_EVS_SendEvent(VC0706_LEN_ERR_EID, CFE_EVS_ERROR, "Camera %d  image too large. Length [%u] Expected <= 20000", cam->ttyInterface, len);
-        resumeVideo(cam);
-        clearBuffer(cam);
-        return takePicture(cam, file_path);
+        OS_printf("VC0706: refusing malformed command 0x%02x with %u argument bytes\n", cmd, argLen);
+        return expect;
     }
-    // Initialize the array to read the image into
-    char image[len + 1];
-    int imgIndex = 0;
 
-    // May have to read the entire buffer multiple times, so we'll have to loop
-    while (len > 0)
+    frame[0] = COMMAND_BEGIN;
+    frame[1] = cam->serialNum;
+    frame[2] = cmd;
+    memcpy(&frame[3], args, argLen);
+
+    if (writeAll(cam->fd, frame, argLen + 3, wireTimeMs(cam, argLen + 3)) != argLen + 3)
+        return expect;
+
+    expect.cmd = cmd;
+    expect.dataLen = spec->replyData;
+    expect.tail = spec->tail;
+    return expect;
+}
+
+/**
+ * Checks a reply header against the reply a command should get.
+ * \param expect - The reply returned by sendCommand()
+ * \param hdr - The reply header received
+ * \returns true if the header answers the command successfully
+ */
+bool replyMatches(const VC0706_Reply_t *expect, const uint8_t hdr[VC0706_REPLY_HEADER_LEN])
+{
+    return expect->cmd != 0 && hdr[0] == COMMAND_SUCCESS && hdr[1] == expect->serial && hdr[2] == expect->cmd &&
+           hdr[3] == 0x00;
+}
+
+/**
+ * Asks the camera for a section of its frozen frame buffer (READ_FBUF).
+ * \param cam - A pointer to the camera to command
+ * \param offset - The byte offset into the frame buffer to start reading from
+ * \param length - The number of bytes to read
+ * \returns The reply to expect, as from sendCommand()
+ */
+VC0706_Reply_t requestChunk(Camera_t *cam, uint32 offset, uint32 length)
+{
+    uint8_t readFrameBufferArgs[] = {0x0C, 0x00, 0x0A,
+                                     (uint8_t)(offset >> 24 & 0xFF), (uint8_t)(offset >> 16 & 0xFF),
+                                     (uint8_t)(offset >> 8 & 0xFF), (uint8_t)(offset & 0xFF),
+                                     (uint8_t)(length >> 24 & 0xFF), (uint8_t)(length >> 16 & 0xFF),
+                                     (uint8_t)(length >> 8 & 0xFF), (uint8_t)(length & 0xFF),
+                                     (uint8_t)(CAMERADELAY >> 8), (uint8_t)(CAMERADELAY & 0xFF)};
+    return sendCommand(cam, READ_FBUF, readFrameBufferArgs, sizeof(readFrameBufferArgs));
+}
+
+/**
+ * Downloads the camera's frozen frame in VC0706_CHUNK_SIZE pieces, handing each one to a sink as it completes.
+ *
+ * Each chunk is read with bulk read() calls rather than a byte at a time into the next slot of the camera's ring
+ * buffer. The READ_FBUF request for the next chunk goes out as soon as the current chunk's reply header checks out,
+ * so by the time the sink runs (e.g. an OS_write) the camera is already sending the following chunk. Memory use is
+ * the ring alone, whatever the frame length. The achieved link rate is stored in cam->bytesPerSec.
+ *
+ * Chunks reach the sink in order, so the bytes received intact are always [0, cam->frameptr). When a chunk fails,
+ * the line is left to go quiet and only the rest of the frame is requested again, up to VC0706_Config.retryBudget
+ * times per frame.
+ * \param[in,out] cam - A pointer to the camera to download from
+ * \param len - The length of the frame, as reported by GET_FBUF_LEN
+ * \param sink - Called with each validated chunk, in order. A negative return aborts the download.
+ * \param ctx - Passed through to sink
+ * \returns The number of bytes downloaded and accepted by the sink, which is less than len on failure
+ */
+int downloadFrame(Camera_t *cam, uint32 len, ChunkSink_t sink, void *ctx)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    cam->frameptr = 0;
+    uint8 retries = 0;
+    uint32 chunk = len < VC0706_CHUNK_SIZE ? len : VC0706_CHUNK_SIZE;
+    if (len > 0)
+        requestChunk(cam, 0, chunk);
+
+    while ((uint32)cam->frameptr < len)
     {
-        unsigned int readBytes = len;
-        // TODO: figure out how to refactor this into something friendlier to readers
-        serialPutchar(cam->fd, (char)COMMAND_BEGIN);
-        serialPutchar(cam->fd, (char)cam->serialNum);
-        serialPutchar(cam->fd, (char)READ_FBUF);
-        serialPutchar(cam->fd, (char)0x0C);
-        serialPutchar(cam->fd, (char)0x0);
-        serialPutchar(cam->fd, (char)0x0A);
-        serialPutchar(cam->fd, (char)(cam->frameptr >> 24 & 0xff));
-        serialPutchar(cam->fd, (char)(cam->frameptr >> 16 & 0xff));
-        serialPutchar(cam->fd, (char)(cam->frameptr >> 8 & 0xff));
-        serialPutchar(cam->fd, (char)(cam->frameptr & 0xFF));
-        serialPutchar(cam->fd, (char)(readBytes >> 24 & 0xff));
-        serialPutchar(cam->fd, (char)(readBytes >> 16 & 0xff));
-        serialPutchar(cam->fd, (char)(readBytes >> 8 & 0xff));
-        serialPutchar(cam->fd, (char)(readBytes & 0xFF));
-        serialPutchar(cam->fd, (char)(CAMERADELAY >> 8));
-        serialPutchar(cam->fd, (char)(CAMERADELAY & 0xFF));
+        const char *failure = NULL;
+        uint32 nextChunk = 0;
+        uint8_t *slot = NULL;
 
+        CFE_ES_PerfLogEntry(VC0706_CHUNK_PERF_ID);
         if (!checkReply(cam, READ_FBUF, 5))
         {
-            OS_printf("VC0706: Error! checkReply(cam, READ_FBUF, 5) returned false.\n");
-            return "";
+            failure = "header invalid";
         }
-
-        int counter = 0;
-        cam->bufferLen = 0;
-        int avail = 0;
-        int timeout = 20 * TO_SCALE;
-
-        while ((timeout < counter) && cam->bufferLen < readBytes)
+        else
         {
-            avail = serialDataAvail(cam->fd);
-
-            if (avail <= 0)
+            // Queue up the next chunk while this one is still on the wire
+            uint32 next = cam->frameptr + chunk;
+            if (next < len)
             {
-                usleep(TO_U);
-                counter++;
-                continue;
+                nextChunk = (len - next) < VC0706_CHUNK_SIZE ? (len - next) : VC0706_CHUNK_SIZE;
+                requestChunk(cam, next, nextChunk);
             }
-            counter = 0;
-            int newChar = serialGetchar(cam->fd);
 
-            image[imgIndex++] = (char)newChar;
+            slot = cam->ring[cam->ringHead];
+            cam->ringHead = (cam->ringHead + 1) % VC0706_RING_SLOTS;
 
-            cam->bufferLen++;
+            cam->bufferLen = readBytes(cam, slot, (int)chunk, wireTimeMs(cam, chunk));
+            if ((uint32)cam->bufferLen != chunk)
+                failure = "short chunk";
+            else if (!checkReply(cam, READ_FBUF, 5))
+                failure = "tail invalid";
         }
+        CFE_ES_PerfLogExit(VC0706_CHUNK_PERF_ID);
 
-        cam->frameptr += readBytes;
-        len -= readBytes;
-
-        if (!checkReply(cam, READ_FBUF, 5))
+        if (failure != NULL)
         {
-            OS_printf("ERROR READING END OF CHUNK| start: %u | length: %u\n", cam->frameptr, len);
+            OS_printf("VC0706: Error! READ_FBUF %s at offset %d (%u bytes)\n", failure, cam->frameptr, chunk);
+            if (retries >= VC0706_Config.retryBudget)
+            {
+                VC0706_CaptureTlmPkt.vc0706_retries_exhausted++;
+                return cam->frameptr;
+            }
+
+            // Let the rest of this chunk and the one queued after it go by, then pick up where the stored bytes end
+            retries++;
+            VC0706_CaptureTlmPkt.vc0706_chunk_retries++;
+            VC0706_CaptureTlmPkt.vc0706_bytes_resumed += (uint32)cam->frameptr;
+            rxReset(&cam->rx);
+            pollDrain(cam->fd, VC0706_RETRY_QUIET_MS, wireTimeMs(cam, 2 * (VC0706_CHUNK_SIZE + 2 * VC0706_REPLY_HEADER_LEN)));
+            chunk = (len - cam->frameptr) < VC0706_CHUNK_SIZE ? (len - cam->frameptr) : VC0706_CHUNK_SIZE;
+            requestChunk(cam, cam->frameptr, chunk);
+            continue;
         }
+
+        // The next chunk is already streaming in, so this overlaps with the receive
+        if (sink(ctx, slot, chunk) < 0)
+            return cam->frameptr;
+        cam->frameptr += chunk;
+        chunk = nextChunk;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t elapsedUs = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    cam->bytesPerSec = elapsedUs > 0 ? (uint32)((uint64_t)len * 1000000 / elapsedUs) : 0;
+    CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_INFORMATION, "Camera %d read %u bytes in %u ms (%u B/s)",
+                      cam->ttyInterface, len, (unsigned int)(elapsedUs / 1000), cam->bytesPerSec);
+    return (int)len;
+}
+
+/**
+ * Tells the camera to hold its current frame in memory so it can be retrieved. Does not wait for the reply, so several
+ * cameras can be frozen back-to-back; fetchFrame() checks the reply.
+ * \param[in,out] cam - A pointer to the camera to freeze
+ */
+void freezeFrame(Camera_t *cam)
+{
+    // Reset the frame pointer
+    cam->frameptr = 0;
+
+    uint8_t frameBufferControlArgs[] = {0x01, STOPCURRENTFRAME};
+    CFE_ES_PerfLogEntry(VC0706_FREEZE_PERF_ID); // ends when fetchFrame() has the reply
+    sendCommand(cam, FBUF_CTRL, frameBufferControlArgs, sizeof(frameBufferControlArgs));
+}
+
+/**
+ * Retrieves a frame held by freezeFrame() and streams it to the storage task to be written to disk.
+ * \param[in,out] cam - A pointer to the camera that was frozen
+ * \param file_path - The name of the file to save to
+ * \returns The image name once the whole frame has been handed to storage, "" if the camera failed,
+ *          or NULL if storage could not accept the image
+ */
+char *fetchFrame(Camera_t *cam, char *file_path)
+{
+    bool frozen = checkReply(cam, FBUF_CTRL, 5);
+    CFE_ES_PerfLogExit(VC0706_FREEZE_PERF_ID);
+    if (!frozen)
+    {
+        OS_printf("Frame checkReply Failed\n");
+        return "";
+    }
+
+    uint8_t getFrameBufferLengthArgs[] = {0x01, 0x00};
+    CFE_ES_PerfLogEntry(VC0706_LENGTH_PERF_ID);
+    sendCommand(cam, GET_FBUF_LEN, getFrameBufferLengthArgs, sizeof(getFrameBufferLengthArgs));
+
+    // Retrieve the image's length from the camera (big-endian, follows the reply header)
+    uint8_t lenBytes[4];
+    bool lengthValid = checkReply(cam, GET_FBUF_LEN, 5);
+    int lenRead = lengthValid ? readBytes(cam, lenBytes, sizeof(lenBytes), wireTimeMs(cam, sizeof(lenBytes))) : 0;
+    CFE_ES_PerfLogExit(VC0706_LENGTH_PERF_ID);
+    if (!lengthValid)
+    {
+        OS_printf("FBUF_LEN REPLY NOT VALID!!!\n");
+        return "";
     }
+    if (lenRead != sizeof(lenBytes))
+    {
+        OS_printf("FBUF_LEN LENGTH NOT RECEIVED!!!\n");
+        return "";
+    }
+    unsigned int len = ((unsigned int)lenBytes[0] << 24) | ((unsigned int)lenBytes[1] << 16) |
+                       ((unsigned int)lenBytes[2] << 8) | lenBytes[3];
 
-    int32 pic_fd = OS_creat(file_path, (int32)OS_READ_WRITE);
-    if (!(pic_fd < OS_FS_SUCCESS)) // if successful file creat
+    // A length beyond anything the camera can hold means the reply was garbled
+    if (len == 0 || len > VC0706_MAX_FRAME_LEN)
     {
-        OS_write(pic_fd, (void *)image, imgIndex);
-        OS_close(pic_fd);
+        CFE_EVS_SendEvent(VC0706_LEN_ERR_EID, CFE_EVS_ERROR, "Camera %d image length invalid. Length [%u] Expected 1 - %u", cam->ttyInterface, len, VC0706_MAX_FRAME_LEN);
+        resumeVideo(cam);
+        clearBuffer(cam);
+        return "";
     }
-    else
+
+    // Hand the file to the storage task up front so chunks can be written out as they arrive
+    if (VC0706_StorageBegin(cam->ttyInterface, file_path, len, VC0706_PRIORITY_ROUTINE) == -1)
     {
-        CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_ERROR, "IMAGE FILE COULD NOT BE OPENED/MADE!");
+        resumeVideo(cam);
+        clearBuffer(cam);
         return (char *)NULL;
     }
 
-    strncpy(cam->imageName, file_path, strlen(file_path));
+    int downloaded = downloadFrame(cam, len, VC0706_StorageWrite, &cam->ttyInterface);
+
+    // Storage closes (or, on a failed download, deletes) the file and announces it while we move on
+    VC0706_StorageEnd(cam->ttyInterface, downloaded == (int)len);
+
     resumeVideo(cam);
 
     //Clear Buffer
     clearBuffer(cam);
 
-    CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_ERROR, "Camera %d stored as <%s>", cam->ttyInterface, cam->imageName);
+    if (downloaded != (int)len)
+        return "";
+
+    snprintf(cam->imageName, sizeof(cam->imageName), "%s", file_path);
+
+    CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_INFORMATION, "Camera %d queued <%s> for storage", cam->ttyInterface, cam->imageName);
     return cam->imageName;
 }
+
+/**
+ * Takes a picture and streams it to the storage task to be written to disk.
+ * \param[in,out] cam - A pointer to the camera to take a picture with
+ * \param file_path - The name of the file to save to
+ * \returns The image name once the whole frame has been handed to storage, "" if the camera failed,
+ *          or NULL if storage could not accept the image
+ */
+char *takePicture(Camera_t *cam, char *file_path)
+{
+    // Enable LED
+    CFE_ES_PerfLogEntry(VC0706_LED_PERF_ID);
+    led_on(&led);     // initialized in vc0706_device.c
+    OS_TaskDelay(50); // wait one 1ms to allow the LED to heat up
+    CFE_ES_PerfLogExit(VC0706_LED_PERF_ID);
+
+    // Clear Buffer
+    clearBuffer(cam);
+
+    // Tell the camera to hold the current frame (holds it in memory on the camera board so we can retrieve it)
+    freezeFrame(cam);
+
+    // Disable LED
+    led_off(&led);
+
+    return fetchFrame(cam, file_path);
+}
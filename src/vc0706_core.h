@@ -11,8 +11,15 @@
 
 #include "vc0706.h"
 
-/** Baud rate to use on the serial interface for the camera */
+/** Device path of each camera's serial port, formatted with its tty interface number. Can be overridden from
+ * LOCAL_COPTS to point the app at tools/vc0706_emu instead of real cameras. */
+#ifndef VC0706_TTY_PATH_FMT
+#define VC0706_TTY_PATH_FMT "/dev/ttyAMA%d"
+#endif
+/** Baud rate the camera comes up at after power-on or reset */
 #define BAUD 38400
+/** Time in milliseconds the camera needs to reboot after a reset command */
+#define VC0706_RESET_DELAY_MS 1000
 /** The code that signals the beginning of a command */
 #define COMMAND_BEGIN 0x56
 /** The code returned after a successful operation */
@@ -31,6 +38,8 @@
 #define DOWNSIZE_CTRL 0x54
 /** The downsize status command code */
 #define DOWNSIZE_STATUS 0x55
+/** The set serial port (baud rate) command code */
+#define SET_PORT 0x24
 /** The read data command code */
 #define READ_DATA 0x30
 /** The write data command code */
@@ -63,6 +72,14 @@
 #define SIZE320 0x11
 /** The code for setting the image size to 160p */
 #define SIZE160 0x22
+/** imageSizeApplied when the camera's size couldn't be read back, so the wanted size is always written */
+#define SIZE_UNKNOWN 0xFF
+/** Downsize code for full size output */
+#define DOWNSIZE_NONE 0x00
+/** Downsize code for half width and height */
+#define DOWNSIZE_HALF 0x11
+/** Downsize code for quarter width and height */
+#define DOWNSIZE_QUARTER 0x22
 /** The command code for setting the zoom */
 #define SET_ZOOM 0x52
 /** The command code for getting the zoom */
@@ -71,10 +88,72 @@
 #define CAMERABUFFSIZ 100
 /** The delay on the camera */
 #define CAMERADELAY 10
+/** Number of image bytes requested per READ_FBUF command when downloading a frame */
+#define VC0706_CHUNK_SIZE 1024
+/** Number of chunk-sized slots in each camera's receive ring */
+#define VC0706_RING_SLOTS 2
+/** Largest frame length accepted from GET_FBUF_LEN. Anything larger is treated as a garbled reply. */
+#define VC0706_MAX_FRAME_LEN 0x40000
+/** The camera's compression ratio after power-on or reset */
+#define VC0706_DEFAULT_COMPRESSION 0x36
+/** Lowest compression ratio the size controller will use (largest, best-quality frames) */
+#define VC0706_MIN_COMPRESSION 0x10
+/** Highest compression ratio the size controller will use (smallest frames) */
+#define VC0706_MAX_COMPRESSION 0xFF
+/** Frames within this percentage of the size target leave the compression ratio alone */
+#define VC0706_SIZE_TOLERANCE_PCT 10
+/** Compression steps applied per percent of size error */
+#define VC0706_COMPRESSION_GAIN_NUM 1
+/** Divisor for VC0706_COMPRESSION_GAIN_NUM */
+#define VC0706_COMPRESSION_GAIN_DEN 2
+/** Largest change the size controller makes to the compression ratio between frames */
+#define VC0706_COMPRESSION_MAX_STEP 32
 /** The scale of all the timeouts for this app (add to this to slow down sample rates, subtract to speed up) */
 #define TO_SCALE 1
-/** The default timeout in microseconds */
-#define TO_U 200000
+/** Time in milliseconds allowed for a command's reply to arrive, on top of its time on the wire */
+#define VC0706_REPLY_TIMEOUT_MS (600 * TO_SCALE)
+/** How long in milliseconds the line must be idle before clearBuffer() considers it empty */
+#define VC0706_DRAIN_QUIET_MS 5
+/** The longest clearBuffer() will spend discarding bytes, in milliseconds */
+#define VC0706_DRAIN_MAX_MS 250
+/** How long in milliseconds the line must be idle after a failed chunk before the rest of the frame is re-requested */
+#define VC0706_RETRY_QUIET_MS 50
+
+/** Longest command frame sendCommand() will build: begin, serial number, command and up to 16 argument bytes */
+#define VC0706_MAX_COMMAND_LEN 19
+/** Length of a VC0706 reply header (0x76, serial number, command, status, data length), and of the READ_FBUF tail */
+#define VC0706_REPLY_HEADER_LEN 5
+/** Length of the version string that follows a GEN_VERSION reply header */
+#define VC0706_VERSION_LEN 11
+/** Reply data length for commands whose reply carries a variable amount of data, as given in the reply header */
+#define VC0706_REPLY_DATA_VARIABLE 0xFF
+
+/**
+ * The reply a command should get back. Returned by sendCommand() so the reply can be checked without the caller
+ * having to know each command's reply layout.
+ */
+typedef struct
+{
+    uint8 cmd;     /**< The command code the reply echoes, or 0 if the command could not be sent */
+    uint8 serial;  /**< The serial number the reply echoes */
+    uint8 dataLen; /**< Bytes of data after the reply header, or VC0706_REPLY_DATA_VARIABLE */
+    bool tail;     /**< Whether a second reply frame follows the data (READ_FBUF) */
+} VC0706_Reply_t;
+
+/** Size of each camera's receive ring for reply framing. Must be a power of two. */
+#define VC0706_RX_RING_SIZE 256
+
+/**
+ * Bytes received from a camera that haven't been parsed yet. Kept across reads so replies can be framed
+ * incrementally, whatever size pieces the bytes arrive in.
+ */
+typedef struct
+{
+    uint8_t buf[VC0706_RX_RING_SIZE]; /**< The received bytes */
+    uint16 head;                      /**< Index of the oldest unparsed byte */
+    uint16 count;                     /**< Number of unparsed bytes */
+    uint32 motionAlerts;              /**< Unsolicited motion-detected frames seen and not yet collected */
+} VC0706_RxRing_t;
 
 /**
  * Represents a VC0706 camera attached via serial
@@ -86,20 +165,57 @@ typedef struct Camera_t {
     int fd; /**< The handle for the serial connection */
 
     int frameptr; /**< Points to the next frame in the buffer during large read operations */
-    int bufferLen; /**< Length of the camera's buffer */
+    int bufferLen; /**< Number of bytes received for the chunk currently being downloaded */
     int serialNum; /**< Serial number of the camera. Used for sending commands */
+    uint32 bytesPerSec; /**< Link throughput achieved during the last image download */
+    uint32 baud; /**< The baud rate the serial link is currently running at */
+    uint32 baudHistory[VC0706_BAUD_HISTORY_LEN]; /**< Rates chosen by past negotiations, newest first */
+    uint8 baudFallbacks; /**< Number of rates that failed verification and had to be backed out of */
+    uint8 compression; /**< Compression ratio the size controller wants for the next frame */
+    uint8 compressionApplied; /**< Compression ratio the camera is currently set to */
+    uint32 lastFrameLen; /**< Length of the last frame downloaded */
+    uint8 imageSize; /**< Resolution (SIZE640, SIZE320 or SIZE160) wanted for the next frame */
+    uint8 imageSizeApplied; /**< Resolution held in the camera's EEPROM, as last read back, or SIZE_UNKNOWN */
+    uint8 downsize; /**< Downsize level (DOWNSIZE_NONE, _HALF or _QUARTER) wanted for the next frame */
+    uint8 downsizeApplied; /**< Downsize level the camera is currently set to */
     char imageName[OS_MAX_PATH_LEN]; /**< Name of the saved image. Uses OSAL's max path length macro to define its length */
+
+    uint8_t ring[VC0706_RING_SLOTS][VC0706_CHUNK_SIZE]; /**< Receive ring that frame chunks are downloaded into */
+    uint8 ringHead; /**< The ring slot the next chunk will be received into */
+    VC0706_RxRing_t rx; /**< Received bytes waiting to be framed into replies */
 } Camera_t;
 
+/**
+ * Consumer for frame chunks produced by downloadFrame()
+ * \returns 0 to continue the download, or a negative value to abort it
+ */
+typedef int (*ChunkSink_t)(void *ctx, const uint8_t *data, uint32 len);
+
 
 int init(Camera_t *cam, uint8 ttyInterface);
+uint32 wireTimeMs(Camera_t *cam, uint32 bytes);
+int readBytes(Camera_t *cam, uint8_t *buf, int len, uint32 timeoutMs);
+int readCamera(Camera_t *cam, uint8_t *reply, int size, uint32 timeoutMs);
+void countReplyFailure(uint8 cmd, bool timedOut);
 bool checkReply(Camera_t *cam, int cmd, int size);
 void clearBuffer(Camera_t *cam);
 void reset(Camera_t *cam);
+int setBaud(Camera_t *cam, uint32 baud);
+uint32 negotiateBaud(Camera_t *cam);
 void resumeVideo(Camera_t *cam);
 int  getVersion(Camera_t *cam);
 void setMotionDetect(Camera_t *cam, bool flag);
+void compressionArgs(uint8_t args[6], uint8 ratio);
+void imageSizeArgs(uint8_t args[6], uint8 size);
+uint8 readImageSize(Camera_t *cam);
+int setImageSize(Camera_t *cam, uint8 size);
+void adjustCompression(Camera_t *cam, uint32 frameLen, uint32 targetBytes);
+VC0706_Reply_t requestChunk(Camera_t *cam, uint32 offset, uint32 length);
+int downloadFrame(Camera_t *cam, uint32 len, ChunkSink_t sink, void *ctx);
+void freezeFrame(Camera_t *cam);
+char * fetchFrame(Camera_t *cam, char * file_path);
 char * takePicture(Camera_t *cam, char * file_path);
-void sendCommand(Camera_t *cam, uint8_t cmd, uint8_t args[], uint8_t argLen);
+VC0706_Reply_t sendCommand(Camera_t *cam, uint8_t cmd, const uint8_t args[], uint8_t argLen);
+bool replyMatches(const VC0706_Reply_t *expect, const uint8_t hdr[VC0706_REPLY_HEADER_LEN]);
 
 #endif
\ No newline at end of file
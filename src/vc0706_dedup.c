@@ -0,0 +1,117 @@
+/**
+ * \file vc0706_dedup.c
+ * \brief Drops frames that are nearly the same as the last frame kept from their camera
+ *
+ * Once a frame has been stored and passed the JPEG check, the storage task builds its signature. The signature is a
+ * 16x16 grid of mean brightness, made from the luma DC coefficients decoded straight from the entropy-coded data, the
+ * same way thumbnails are made. It is compared with the signature of the last frame kept from the same camera. If no
+ * more cells than the ground-set distance have changed brightness, the frame is a repeat. It's deleted before its CRC,
+ * thumbnail or TIM notification, so an unchanging scene costs neither RAM disk nor downlink. Frames are always
+ * compared with the last one kept, not the last one seen, so a slow drift still produces a new frame once it adds up.
+ */
+#include "vc0706_dedup.h"
+#include "vc0706_child.h"
+#include "vc0706_serial.h"
+#include "vc0706_thumb.h"
+#include "vc0706_timing.h"
+
+/** Decoder state, kept here because it's far larger than the storage task's stack. Only the storage task uses it. */
+static VC0706_ThumbDecoder_t VC0706_DedupDecoder;
+/** Signature of the last frame kept from each camera */
+static VC0706_Signature_t VC0706_LastKept[VC0706_MAX_CAMERAS];
+
+/**
+ * Averages the decoded block means into a signature grid.
+ * \param d - A decoder that has just decoded a frame
+ * \param sig - Where to put the signature
+ */
+static void makeSignature(const VC0706_ThumbDecoder_t *d, VC0706_Signature_t *sig)
+{
+    uint32 gx, gy;
+
+    for (gy = 0; gy < VC0706_DEDUP_GRID; gy++)
+    {
+        // Every cell covers at least one block, even when the frame is smaller than the grid
+        uint32 y0 = gy * d->thumbHeight / VC0706_DEDUP_GRID;
+        uint32 y1 = (gy + 1) * d->thumbHeight / VC0706_DEDUP_GRID;
+        if (y1 <= y0)
+            y1 = y0 + 1;
+
+        for (gx = 0; gx < VC0706_DEDUP_GRID; gx++)
+        {
+            uint32 x0 = gx * d->thumbWidth / VC0706_DEDUP_GRID;
+            uint32 x1 = (gx + 1) * d->thumbWidth / VC0706_DEDUP_GRID;
+            uint32 sum = 0;
+            uint32 x, y;
+            if (x1 <= x0)
+                x1 = x0 + 1;
+
+            for (y = y0; y < y1; y++)
+            {
+                for (x = x0; x < x1; x++)
+                    sum += d->pixels[y * d->thumbWidth + x];
+            }
+            sig->cells[gy * VC0706_DEDUP_GRID + gx] = (uint8)(sum / ((y1 - y0) * (x1 - x0)));
+        }
+    }
+    sig->width = d->thumbWidth;
+    sig->height = d->thumbHeight;
+    sig->valid = true;
+}
+
+/**
+ * Measures how far apart two signatures are. Counting changed cells, rather than averaging the difference, keeps a
+ * small object entering the scene from being diluted by the rest of the frame.
+ * \returns The number of cells whose brightness changed by more than VC0706_DEDUP_CELL_NOISE
+ */
+static uint32 signatureDistance(const VC0706_Signature_t *a, const VC0706_Signature_t *b)
+{
+    uint32 changed = 0;
+    int i;
+
+    for (i = 0; i < VC0706_DEDUP_GRID * VC0706_DEDUP_GRID; i++)
+    {
+        if (abs((int)a->cells[i] - (int)b->cells[i]) > VC0706_DEDUP_CELL_NOISE)
+            changed++;
+    }
+    return changed;
+}
+
+/**
+ * Checks whether a stored frame is close enough to its camera's last kept frame to be dropped. Frames that are kept
+ * become the new reference. Called by the storage task once a frame has passed the JPEG check.
+ * \param stream - The camera the frame comes from
+ * \param path - The full path of the file holding the frame
+ * \param offset - Where the frame starts in the file: 0 for a single image, the frame's offset within a segment
+ * \returns true if the frame is a repeat and should be deleted, false to keep it (including when it can't be decoded)
+ */
+bool VC0706_DedupIsRepeat(int stream, const char *path, uint32 offset)
+{
+    VC0706_Signature_t sig;
+    bool repeat = false;
+
+    if (VC0706_Config.dedupDistance == 0 || stream < 0 || stream >= VC0706_MAX_CAMERAS)
+        return false;
+
+    uint64_t startUs = monotonicUs();
+    if (VC0706_ThumbDecode(&VC0706_DedupDecoder, path, offset) != 0)
+    {
+        // Better to send a frame we can't judge than to lose one that mattered
+        VC0706_TimingRecord(VC0706_PHASE_DEDUP, monotonicUs() - startUs);
+        return false;
+    }
+    makeSignature(&VC0706_DedupDecoder, &sig);
+
+    VC0706_Signature_t *last = &VC0706_LastKept[stream];
+    if (last->valid && last->width == sig.width && last->height == sig.height)
+    {
+        uint32 distance = signatureDistance(&sig, last);
+        VC0706_CaptureTlmPkt.vc0706_last_distance = distance;
+        repeat = distance <= VC0706_Config.dedupDistance;
+    }
+    if (!repeat)
+        *last = sig;
+
+    VC0706_TimingRecord(VC0706_PHASE_DEDUP, monotonicUs() - startUs);
+    return repeat;
+}
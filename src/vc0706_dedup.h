@@ -0,0 +1,29 @@
+/**
+ * \file vc0706_dedup.h
+ * \brief Header for the near-duplicate frame check run by the storage task
+ */
+#ifndef _vc0706_dedup_h_
+#define _vc0706_dedup_h_
+
+#include "vc0706.h"
+
+/** Cells along each side of a frame signature. Each cell holds the mean brightness of its part of the frame. */
+#define VC0706_DEDUP_GRID 16
+/** Most a cell's brightness may change between frames and still count as unchanged. Covers sensor noise, small
+ *  exposure steps and the difference compression settings make. */
+#define VC0706_DEDUP_CELL_NOISE 12
+
+/**
+ * A frame's signature: a coarse greyscale picture of it, built from the luma DC coefficients
+ */
+typedef struct
+{
+    uint8 cells[VC0706_DEDUP_GRID * VC0706_DEDUP_GRID]; /**< Mean brightness of each cell, row by row */
+    uint16 width;                                       /**< Width in blocks of the frame it came from */
+    uint16 height;                                      /**< Height in blocks of the frame it came from */
+    bool valid;                                         /**< Whether this holds a signature yet */
+} VC0706_Signature_t;
+
+bool VC0706_DedupIsRepeat(int stream, const char *path, uint32 offset);
+
+#endif
@@ -3,8 +3,12 @@
  * \brief Contains additional VC0706 communication logic (see vc0706_core.c)
  */
 #include "vc0706.h"
+#include "vc0706_catalog.h"
 #include "vc0706_child.h"
 #include "vc0706_device.h"
+#include "vc0706_reactor.h"
+#include "vc0706_sched.h"
+#include "vc0706_serial.h"
 
 /** Parallel Pins */
 int PARALLEL_PIN_BUS[6] = {36, 35, 34, 33, 32, 31};
@@ -12,29 +16,126 @@ int PARALLEL_PIN_BUS[6] = {36, 35, 34, 33, 32, 31};
 // External References
 extern vc0706_hk_tlm_t VC0706_HkTelemetryPkt;
 extern struct led_t led; /**< LED instance from vc0706.c */
-extern struct Camera_t cam;
+extern struct Camera_t cams[VC0706_MAX_CAMERAS];
 
 /** Holds the number of times the system has rebooted (populated by VC0706_setNumReboots()) */
 char num_reboots[3];
 
+/** Number of cameras that have been through init() so far */
+static int VC0706_CamerasOpened = 0;
+
+/** Times (monotonic ms) of the most recent motion alerts, as a ring */
+static uint64_t VC0706_MotionTimes[VC0706_MAX_MOTION_SENSITIVITY];
+/** Next slot of VC0706_MotionTimes to fill */
+static int VC0706_MotionHead = 0;
+/** Whether camera-side motion reporting is currently switched on */
+static bool VC0706_MotionEnabled = false;
+
+/**
+ * Initializes any cameras that have been enabled since the last call. Cameras that fail init are skipped.
+ * \returns The number of cameras currently enabled and ready
+ */
+static int VC0706_openCameras(void)
+{
+    int count = VC0706_Config.cameraCount;
+    int ready = 0;
+    int i;
+
+    if (count > VC0706_MAX_CAMERAS)
+        count = VC0706_MAX_CAMERAS;
+
+    for (; VC0706_CamerasOpened < count; VC0706_CamerasOpened++)
+    {
+        if (init(&cams[VC0706_CamerasOpened], (uint8)VC0706_CamerasOpened) == -1) // Error
+            OS_printf("Camera %d initialization error.\n", VC0706_CamerasOpened);
+
+        // Have the capture mode re-applied so the new camera reports motion too
+        VC0706_MotionEnabled = false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (cams[i].ready)
+            ready++;
+    }
+    return ready;
+}
+
+/**
+ * Switches motion reporting on every ready camera on or off to match the capture mode.
+ */
+static void VC0706_applyCaptureMode(void)
+{
+    bool want = VC0706_Config.captureMode == VC0706_MODE_MOTION;
+    int i;
+
+    if (want == VC0706_MotionEnabled)
+        return;
+
+    for (i = 0; i < VC0706_Config.cameraCount && i < VC0706_MAX_CAMERAS; i++)
+    {
+        if (cams[i].ready)
+            setMotionDetect(&cams[i], want);
+    }
+    memset(VC0706_MotionTimes, 0, sizeof(VC0706_MotionTimes));
+    VC0706_MotionEnabled = want;
+}
+
+/**
+ * Idles until the cameras have reported enough motion within the window to justify a capture.
+ * \param timeoutMs - Longest time to wait for the cameras to report anything
+ * \returns true if a capture should be taken, false if the wait timed out (so settings can be re-checked)
+ */
+bool VC0706_waitForMotion(uint32 timeoutMs)
+{
+    uint32 alerts[VC0706_MAX_CAMERAS];
+    int i;
+
+    if (VC0706_ReactorWaitMotion(timeoutMs, alerts) == 0)
+        return false;
+
+    uint64_t now = monotonicMs();
+    for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+    {
+        uint32 k;
+        for (k = 0; k < alerts[i]; k++)
+        {
+            VC0706_MotionTimes[VC0706_MotionHead] = now;
+            VC0706_MotionHead = (VC0706_MotionHead + 1) % VC0706_MAX_MOTION_SENSITIVITY;
+            VC0706_HkTelemetryPkt.vc0706_motion_alerts++;
+        }
+    }
+
+    // Count the alerts still inside the window
+    int recent = 0;
+    for (i = 0; i < VC0706_MAX_MOTION_SENSITIVITY; i++)
+    {
+        if (VC0706_MotionTimes[i] != 0 && now - VC0706_MotionTimes[i] <= VC0706_Config.motionWindowMs)
+            recent++;
+    }
+    if (recent < VC0706_Config.motionSensitivity)
+        return false;
+
+    // Each capture needs fresh motion
+    memset(VC0706_MotionTimes, 0, sizeof(VC0706_MotionTimes));
+    VC0706_HkTelemetryPkt.vc0706_motion_captures++;
+    return true;
+}
+
 /**
  * Core loop for taking pictures
  */
 int VC0706_takePics(void)
 {
-    int32 hk_packet_succes = 0;
-
     /*
-    ** Path that pictures should be stored in
-    **
-    ** NOTE: if path is greater than 16 chars, imageName[] in vc0706_core.h will need to be enlarged accordingly.
+    ** Name of the file pictures are stored as, within /ram/images/
     */
-    char path[OS_MAX_PATH_LEN];
-    memset(path, '\0', sizeof(path));
-
     char file_name[15];
     memset(file_name, '\0', sizeof(file_name));
 
+    char path[OS_MAX_PATH_LEN];
+    memset(path, '\0', sizeof(path));
+
     /*
     ** get Num reboots
     */
@@ -47,13 +148,10 @@ int VC0706_takePics(void)
     led_init(&led, (int)LED_PIN);
 
     /*
-    ** Attempt to initalize Camera #1
+    ** One task drives every camera
     */
-    if (init(&cam, 0) == -1) // Error
-    {
-        OS_printf("Camera initialization error.\n");
+    if (VC0706_ReactorInit() == -1)
         return -1;
-    }
 
     /*
     ** Initialize the Parallel Pins
@@ -65,83 +163,79 @@ int VC0706_takePics(void)
     ** w/ no delay
     */
     unsigned int num_pics_stored = 1;
+    int i;
     for (;;)
     {
-
         /*
-        ** Get camera version, another way to check that the camera is working properly. Also necessary for initialization.
-        **
-        ** NOTE: Not sure if this should be done every loop iteration. It is a good way to check on the Camera, but maybe wasteful of time.
+        ** Pick up any change to the number of cameras
         */
-        if ((getVersion(&cam)) == -1)
+        if (VC0706_openCameras() == 0)
         {
-            OS_printf("Failed communication to Camera.\n"); // NOTE: vc0706_core::checkReply() does CVE logging.
-            // return -1; // should never stop the task, just keep trying.
-            continue; // loop start over
+            OS_TaskDelay(1000); // nothing to drive; don't spin
+            continue;
         }
 
         /*
-        ** Set Path for the new image
-	    **
-	    ** Format:
-	    ** /ram/images/<num_reboots>_<camera 0 or 1>_<num_pics_stored>.jpg
+        ** Wait until the capture mode (or a ground burst) says a capture is due
         */
-        //OS_printf("VC0706: Calling sprintf()...\n");
-
-        int ret = 0;
-        ret = snprintf(file_name, sizeof(file_name), "%.3s_%d_%.4u.jpg", num_reboots, cam.ttyInterface, num_pics_stored); // cFS /exe relative path
-        if (ret < 0)
-        {
-            OS_printf("sprintf err: %s\n", strerror(ret));
-            continue;
-        }
-
-        ret = snprintf(path, sizeof(path), "/ram/images/%s", file_name); // cFS /exe relative path
-        if (ret < 0)
-        {
-            OS_printf("sprintf err: %s\n", strerror(ret));
+        VC0706_applyCaptureMode();
+        if (!VC0706_SchedWait())
             continue;
-        }
 
-        /*
-        ** Actually take the picture
-        */
-        //OS_printf("VC0706: Calling takePicture(&cam, \"%s\")...\n", path);
-        char *pic_file_name = takePicture(&cam, path);
-        if (pic_file_name != (char *)NULL)
+        int started = 0;
+        for (i = 0; i < VC0706_Config.cameraCount && i < VC0706_MAX_CAMERAS; i++)
         {
-            //OS_printf("Debug: Camera took picture. Stored at: %s\n", pic_file_name);
+            if (!cams[i].ready)
+                continue;
 
             /*
-		    ** Put Image name on telem packet
-		    */
-            if ((hk_packet_succes = snprintf(VC0706_HkTelemetryPkt.vc0706_filename, 15, "%.*s", 15, (char *)pic_file_name + 12)) < 0) // only use the filename, not path.
-            {
-                OS_printf("VC0706: ERROR: HK sprintf ret [%d] filename [%.*s]\n", (int)hk_packet_succes, 15, (char *)&pic_file_name[12]);
-                // continue
-            }
-            else
+            ** Set Path for the new image. Every camera shares a sequence number so stereo pairs line up.
+            **
+            ** Format:
+            ** /ram/images/<num_reboots>_<camera 0 or 1>_<num_pics_stored>.jpg
+            **
+            ** num_pics_stored wraps from 9999 back to 1 so the name always fits TIM's 15 characters.
+            */
+            int ret = snprintf(file_name, sizeof(file_name), "%.3s_%d_%.4u.jpg", num_reboots, cams[i].ttyInterface, num_pics_stored); // cFS /exe relative path
+            if (ret < 0)
             {
-                //OS_printf("VC0706: Wrote Picture Filename to HK Packet. Sent: '%.*s'\n", 15, (char * )&pic_file_name[12], hk_packet_succes);
-                VC0706_SendTimFileName(file_name);
+                OS_printf("sprintf err: %s\n", strerror(ret));
+                continue;
             }
-            //OS_printf("VC0706: VC0706_HkTelemetryPkt.vc0706_filename: '%s'\n", VC0706_HkTelemetryPkt.vc0706_filename);
-
-            /*
-			** update number of pics taken on the parallel pins
-			*/
-            updatePhotoCount((uint8)num_pics_stored);
+            snprintf(path, sizeof(path), "%s/%s", VC0706_IMAGE_DIR, file_name); // cFS /exe relative path
 
             /*
-		    ** incriment num pics for filename
-		    */
-            num_pics_stored++;
+            ** The reactor probes the camera (GEN_VERSION) before freezing it if it has failed or been quiet for a while,
+            ** so a dead camera drops out here
+            */
+            if (VC0706_ReactorStart(i, path, VC0706_SchedPriority()) == 0)
+                started++;
         }
-        else
+
+        if (started == 0)
+            continue; // loop start over
+
+        /*
+        ** Freeze every camera together and download them all in parallel
+        */
+        int stored = VC0706_ReactorRun();
+
+        /*
+        ** The storage task writes the files, puts their names on the HK packet, notifies TIM and updates the
+        ** parallel photo count, so we can go straight on to the next frame.
+        */
+        for (i = 0; i < VC0706_MAX_CAMERAS; i++)
         {
-            VC0706_SendTimFileName("error.txt"); // contains: "image failed to be taken."
+            if (VC0706_ReactorResult(i) == (char *)NULL)
+                VC0706_SendTimFileName("error.txt", 0); // contains: "image failed to be taken."
         }
 
+        /*
+        ** incriment num pics for filename
+        */
+        if (stored > 0)
+            num_pics_stored = num_pics_stored % 9999 + 1;
+
     } /* Infinite Camera capture Loop End Here */
 
     return (0);
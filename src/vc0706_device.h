@@ -1,4 +1,6 @@
+
 int VC0706_takePics(void);
+bool VC0706_waitForMotion(uint32 timeoutMs);
 void setupParallelPhotoCount(void);
 void updatePhotoCount(uint8 pic_count);
 void VC0706_setNumReboots(void);
\ No newline at end of file
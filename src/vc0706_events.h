@@ -27,5 +27,13 @@
 #define VC0706_CHILD_INIT_EID 8
 /** Child initialization information event ID */
 #define VC0706_CHILD_INIT_INF_EID 10
+/** Configuration command information event ID */
+#define VC0706_COMMANDCFG_INF_EID 11
+/** Capture plan table error event ID */
+#define VC0706_PLAN_ERR_EID 12
+/** Capture plan information event ID */
+#define VC0706_PLAN_INF_EID 13
+/** Downloaded image failed its JPEG structure check event ID */
+#define VC0706_IMAGE_ERR_EID 14
 
 #endif
\ No newline at end of file
@@ -0,0 +1,190 @@
+/**
+ * \file vc0706_jpeg.c
+ * \brief Streaming JPEG structure checks and CRC32 over downloaded images
+ *
+ * The storage task feeds each chunk through here as it writes it, so by the time the last chunk is on disk the image
+ * is known to run from SOI to EOI through well-formed segments, and its CRC32 is ready to go out with the TIM
+ * notification. Nothing is read back from the file.
+ */
+#include "vc0706_jpeg.h"
+
+/** CRC32 (IEEE 802.3, reflected polynomial 0xEDB88320) lookup tables for four bytes at a time */
+static uint32 VC0706_CrcTable[4][256];
+
+/**
+ * Builds the CRC32 lookup tables. Must run before any image is checked.
+ */
+void VC0706_JpegInit(void)
+{
+    uint32 i;
+    int bit;
+
+    for (i = 0; i < 256; i++)
+    {
+        uint32 c = i;
+        for (bit = 0; bit < 8; bit++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        VC0706_CrcTable[0][i] = c;
+    }
+    for (i = 0; i < 256; i++)
+    {
+        VC0706_CrcTable[1][i] = (VC0706_CrcTable[0][i] >> 8) ^ VC0706_CrcTable[0][VC0706_CrcTable[0][i] & 0xFF];
+        VC0706_CrcTable[2][i] = (VC0706_CrcTable[1][i] >> 8) ^ VC0706_CrcTable[0][VC0706_CrcTable[1][i] & 0xFF];
+        VC0706_CrcTable[3][i] = (VC0706_CrcTable[2][i] >> 8) ^ VC0706_CrcTable[0][VC0706_CrcTable[2][i] & 0xFF];
+    }
+}
+
+/**
+ * Continues a CRC32 over more data, four bytes per step (slicing-by-4).
+ * \param crc - The running CRC: 0xFFFFFFFF to start, then the previous return value
+ * \param data - The bytes to add
+ * \param len - The number of bytes
+ * \returns The running CRC. Invert it (~crc) once all the data has been added.
+ */
+uint32 VC0706_Crc32(uint32 crc, const uint8 *data, uint32 len)
+{
+    while (len >= 4)
+    {
+        crc ^= (uint32)data[0] | ((uint32)data[1] << 8) | ((uint32)data[2] << 16) | ((uint32)data[3] << 24);
+        crc = VC0706_CrcTable[3][crc & 0xFF] ^ VC0706_CrcTable[2][(crc >> 8) & 0xFF] ^
+              VC0706_CrcTable[1][(crc >> 16) & 0xFF] ^ VC0706_CrcTable[0][crc >> 24];
+        data += 4;
+        len -= 4;
+    }
+    while (len-- > 0)
+        crc = VC0706_CrcTable[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+/**
+ * Starts checking a new image.
+ */
+void VC0706_JpegBegin(VC0706_JpegCheck_t *check)
+{
+    memset(check, 0, sizeof(*check));
+    check->state = VC0706_JPEG_SOI;
+    check->crc = 0xFFFFFFFFu;
+}
+
+/**
+ * Acts on a marker code.
+ */
+static uint8 jpegMarker(VC0706_JpegCheck_t *check, uint8 code)
+{
+    if (code == 0xFF)
+        return VC0706_JPEG_CODE; // fill byte
+    if (code == 0xD9)
+        return VC0706_JPEG_DONE; // EOI
+    if (code == 0x00 || code == 0xD8)
+        return VC0706_JPEG_BAD; // stuffing outside a scan, or a second SOI
+    if (code == 0x01 || (code >= 0xD0 && code <= 0xD7))
+        return VC0706_JPEG_MARKER; // TEM and RSTn stand alone
+
+    check->code = code;
+    return VC0706_JPEG_LEN_HI;
+}
+
+/**
+ * Checks the next piece of an image's bytes, in order, and adds them to its CRC.
+ * \param[in,out] check - The check begun with VC0706_JpegBegin()
+ * \param data - The bytes
+ * \param len - The number of bytes
+ */
+void VC0706_JpegFeed(VC0706_JpegCheck_t *check, const uint8 *data, uint32 len)
+{
+    uint32 i;
+
+    check->crc = VC0706_Crc32(check->crc, data, len);
+
+    for (i = 0; i < len && check->state != VC0706_JPEG_BAD; i++)
+    {
+        uint8 b = data[i];
+        uint8 next = check->state;
+
+        switch (check->state)
+        {
+        case VC0706_JPEG_SOI:
+            next = b == 0xFF ? VC0706_JPEG_SOI_CODE : VC0706_JPEG_BAD;
+            break;
+        case VC0706_JPEG_SOI_CODE:
+            next = b == 0xD8 ? VC0706_JPEG_MARKER : VC0706_JPEG_BAD;
+            break;
+        case VC0706_JPEG_MARKER:
+            next = b == 0xFF ? VC0706_JPEG_CODE : VC0706_JPEG_BAD;
+            break;
+        case VC0706_JPEG_CODE:
+            next = jpegMarker(check, b);
+            break;
+        case VC0706_JPEG_LEN_HI:
+            check->segLen = (uint16)(b << 8);
+            next = VC0706_JPEG_LEN_LO;
+            break;
+        case VC0706_JPEG_LEN_LO:
+            check->segLen |= b;
+            if (check->segLen < 2)
+            {
+                next = VC0706_JPEG_BAD;
+                break;
+            }
+            check->segLeft = (uint16)(check->segLen - 2);
+            if (check->segLeft > 0)
+                next = VC0706_JPEG_SEGMENT;
+            else
+                next = check->code == 0xDA ? VC0706_JPEG_SCAN : VC0706_JPEG_MARKER;
+            break;
+        case VC0706_JPEG_SEGMENT:
+        {
+            // Skip as much of the body as this piece holds in one go
+            uint32 skip = len - i < check->segLeft ? len - i : check->segLeft;
+            check->segLeft = (uint16)(check->segLeft - skip);
+            i += skip - 1;
+            if (check->segLeft == 0)
+                next = check->code == 0xDA ? VC0706_JPEG_SCAN : VC0706_JPEG_MARKER;
+            break;
+        }
+        case VC0706_JPEG_SCAN:
+        {
+            // Entropy-coded data only matters where a 0xFF is
+            const uint8 *ff = memchr(&data[i], 0xFF, len - i);
+            if (ff == NULL)
+            {
+                i = len - 1;
+                break;
+            }
+            i = (uint32)(ff - data);
+            next = VC0706_JPEG_SCAN_FF;
+            break;
+        }
+        case VC0706_JPEG_SCAN_FF:
+            if (b == 0x00 || (b >= 0xD0 && b <= 0xD7))
+                next = VC0706_JPEG_SCAN; // stuffed 0xFF or a restart marker
+            else if (b != 0xFF)
+                next = jpegMarker(check, b); // end of the scan
+            break;
+        case VC0706_JPEG_DONE:
+            check->trailer++;
+            break;
+        default:
+            break;
+        }
+
+        if (next == VC0706_JPEG_BAD)
+            check->badAt = check->offset + i;
+        check->state = next;
+    }
+    check->offset += len;
+}
+
+/**
+ * Finishes checking an image.
+ * \param[in,out] check - The check fed with every byte of the image
+ * \param[out] crc - Set to the image's CRC32
+ * \returns true if the image is a complete, well-formed JPEG, false if it is truncated or broken
+ */
+bool VC0706_JpegFinish(VC0706_JpegCheck_t *check, uint32 *crc)
+{
+    *crc = ~check->crc;
+    if (check->state != VC0706_JPEG_DONE && check->state != VC0706_JPEG_BAD)
+        check->badAt = check->offset;
+    return check->state == VC0706_JPEG_DONE && check->trailer <= VC0706_JPEG_MAX_TRAILER;
+}
@@ -0,0 +1,54 @@
+/**
+ * \file vc0706_jpeg.h
+ * \brief Header for streaming JPEG structure checks and CRC32 over downloaded images
+ */
+#ifndef _vc0706_jpeg_h_
+#define _vc0706_jpeg_h_
+
+#include "vc0706.h"
+
+/** Appended to an image's path to name the file holding its CRC32 */
+#define VC0706_CRC_SUFFIX ".crc"
+/** Most bytes allowed after the EOI marker; the camera pads some frames out to its buffer granularity */
+#define VC0706_JPEG_MAX_TRAILER 32
+
+/**
+ * Where the JPEG checker is in the image's marker structure
+ */
+typedef enum
+{
+    VC0706_JPEG_SOI,        /**< Expecting the 0xFF of the SOI marker */
+    VC0706_JPEG_SOI_CODE,   /**< Expecting the 0xD8 of the SOI marker */
+    VC0706_JPEG_MARKER,     /**< Expecting the 0xFF that starts the next marker */
+    VC0706_JPEG_CODE,       /**< Expecting a marker code */
+    VC0706_JPEG_LEN_HI,     /**< Expecting the high byte of a segment length */
+    VC0706_JPEG_LEN_LO,     /**< Expecting the low byte of a segment length */
+    VC0706_JPEG_SEGMENT,    /**< Skipping a segment's body */
+    VC0706_JPEG_SCAN,       /**< In entropy-coded scan data */
+    VC0706_JPEG_SCAN_FF,    /**< In scan data, just after a 0xFF */
+    VC0706_JPEG_DONE,       /**< Past the EOI marker */
+    VC0706_JPEG_BAD         /**< The structure is broken; nothing more is checked */
+} VC0706_JpegState_t;
+
+/**
+ * The running state of a check over one image, fed a piece at a time
+ */
+typedef struct
+{
+    uint8 state;    /**< One of VC0706_JpegState_t */
+    uint8 code;     /**< The marker whose segment is being read */
+    uint16 segLen;  /**< Length of the segment being read, including its length field */
+    uint16 segLeft; /**< Bytes of the segment body still to skip */
+    uint32 offset;  /**< Bytes of the image seen so far */
+    uint32 trailer; /**< Bytes seen after the EOI marker */
+    uint32 badAt;   /**< Offset at which the structure broke, in VC0706_JPEG_BAD */
+    uint32 crc;     /**< CRC32 of the bytes seen so far, before the final inversion */
+} VC0706_JpegCheck_t;
+
+void VC0706_JpegInit(void);
+uint32 VC0706_Crc32(uint32 crc, const uint8 *data, uint32 len);
+void VC0706_JpegBegin(VC0706_JpegCheck_t *check);
+void VC0706_JpegFeed(VC0706_JpegCheck_t *check, const uint8 *data, uint32 len);
+bool VC0706_JpegFinish(VC0706_JpegCheck_t *check, uint32 *crc);
+
+#endif
@@ -17,6 +17,63 @@
 */
 #define VC0706_NOOP_CC 0
 #define VC0706_RESET_COUNTERS_CC 1
+#define VC0706_SET_CAMERA_COUNT_CC 2
+#define VC0706_SET_CAPTURE_MODE_CC 3
+#define VC0706_SET_MOTION_PARAMS_CC 4
+#define VC0706_SET_SIZE_TARGET_CC 5
+#define VC0706_SET_RESOLUTION_CC 6
+#define VC0706_SET_PERIOD_CC 7
+#define VC0706_BURST_CC 8
+#define VC0706_DUMP_TIMING_CC 9
+#define VC0706_SET_RETRY_CC 10
+#define VC0706_SET_PROBE_IDLE_CC 11
+#define VC0706_SET_THUMBNAILS_CC 12
+#define VC0706_SET_DEDUP_CC 13
+#define VC0706_SET_STORE_QUOTA_CC 14
+#define VC0706_SET_IMAGE_STATUS_CC 15
+#define VC0706_SET_STORAGE_FORMAT_CC 16
+
+/*
+** VC0706 App capture modes
+*/
+#define VC0706_MODE_CONTINUOUS 0 /* Capture back-to-back */
+#define VC0706_MODE_MOTION 1     /* Capture only when a camera reports motion */
+#define VC0706_MODE_PERIODIC 2   /* Capture once every ground-set period */
+#define VC0706_MODE_WAKEUP 3     /* Capture once per scheduler wakeup message (VC0706_WAKEUP_MID) */
+
+/*
+** What happens to a frame once its chunk retry budget is spent
+*/
+#define VC0706_RETRY_GIVE_UP 0   /* Drop the frame and wait for the next capture as usual */
+#define VC0706_RETRY_RECAPTURE 1 /* Drop the frame and take another one straight away */
+
+/*
+** Priorities given to stored images by what triggered their capture. Lower priorities are evicted first.
+*/
+#define VC0706_PRIORITY_ROUTINE 0   /* Continuous, periodic or wakeup capture */
+#define VC0706_PRIORITY_MOTION 1    /* Capture triggered by motion */
+#define VC0706_PRIORITY_REQUESTED 2 /* Capture plan entry or ground burst */
+
+/*
+** How stored frames are laid out on the RAM disk
+*/
+#define VC0706_FORMAT_FILES 0    /* One JPEG file per frame, each announced to TIM */
+#define VC0706_FORMAT_SEGMENTS 1 /* Each camera's frames appended to a segment with an index, announced when sealed */
+
+/*
+** Capture phases timed for telemetry (indexes of the vc0706_phase_ arrays)
+*/
+#define VC0706_PHASE_SETUP 0  /* Capture start until the camera answered its probe and settings */
+#define VC0706_PHASE_FREEZE 1 /* FBUF_CTRL stop until its reply */
+#define VC0706_PHASE_LENGTH 2 /* GET_FBUF_LEN until the length arrived */
+#define VC0706_PHASE_CHUNK 3  /* Waiting for one READ_FBUF chunk until its last data byte */
+#define VC0706_PHASE_TAIL 4   /* A chunk's last data byte until its tail was checked */
+#define VC0706_PHASE_WRITE 5  /* Writing one chunk to the image file */
+#define VC0706_PHASE_NOTIFY 6 /* Sending the TIM notification for a stored image */
+#define VC0706_PHASE_FRAME 7  /* Capture start until the last chunk was handed to storage */
+#define VC0706_PHASE_THUMB 8  /* Making and announcing one thumbnail */
+#define VC0706_PHASE_DEDUP 9  /* Building one frame's signature and checking it for a repeat */
+#define VC0706_PHASE_COUNT 10
 
 /**
  * A "no arguments" command for this subsystem. Just a header, no command contents.
@@ -27,6 +84,153 @@ typedef struct
 
 } VC0706_NoArgsCmd_t;
 
+/**
+ * Sets how many cameras the app drives, starting from /dev/ttyAMA0. Takes effect at the next capture.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint8 CameraCount;                    /**< Number of cameras, 1 to VC0706_TIM_CAMERAS */
+
+} OS_PACK VC0706_SetCameraCountCmd_t;
+
+/**
+ * Selects how captures are triggered. Takes effect at the next capture.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint8 Mode;                           /**< One of the VC0706_MODE_ values */
+
+} OS_PACK VC0706_SetCaptureModeCmd_t;
+
+/**
+ * Tunes how readily motion alerts trigger a capture in VC0706_MODE_MOTION.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint16 WindowMs;                      /**< Motion alerts older than this no longer count toward a trigger */
+    uint8 Sensitivity;                    /**< Motion alerts needed within the window, 1 to VC0706_MAX_MOTION_SENSITIVITY */
+
+} OS_PACK VC0706_SetMotionParamsCmd_t;
+
+/**
+ * Sets the frame size the compression controller steers toward.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint32 TargetBytes;                   /**< Byte budget per frame, or 0 to stop adjusting compression */
+
+} OS_PACK VC0706_SetSizeTargetCmd_t;
+
+/**
+ * Sets the camera resolution and downsize level. Kept across camera resets; takes effect at the next capture. A new
+ * image size is written to each camera's EEPROM and needs a camera reset, which delays that capture by about a second.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint8 ImageSize;                      /**< SIZE640 (0x00), SIZE320 (0x11) or SIZE160 (0x22) */
+    uint8 Downsize;                       /**< DOWNSIZE_NONE (0x00), DOWNSIZE_HALF (0x11) or DOWNSIZE_QUARTER (0x22) */
+
+} OS_PACK VC0706_SetResolutionCmd_t;
+
+/**
+ * Sets the capture period used in VC0706_MODE_PERIODIC.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint32 PeriodMs;                      /**< Time between captures, VC0706_MIN_PERIOD_MS or more */
+
+} OS_PACK VC0706_SetPeriodCmd_t;
+
+/**
+ * Takes a burst of captures as soon as possible, whatever the capture mode.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint16 Count;                         /**< Number of captures, 1 to VC0706_MAX_BURST */
+
+} OS_PACK VC0706_BurstCmd_t;
+
+/**
+ * Sets how many failed chunks a frame download may re-request, and what to do once they run out.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint8 Budget;                         /**< Chunk re-requests allowed per frame, 0 to VC0706_MAX_RETRY_BUDGET */
+    uint8 Policy;                         /**< VC0706_RETRY_GIVE_UP or VC0706_RETRY_RECAPTURE */
+
+} OS_PACK VC0706_SetRetryCmd_t;
+
+/**
+ * Sets how long a camera may go without answering anything before it's probed with GEN_VERSION ahead of a capture.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint32 IdleMs;                        /**< Idle time before a probe, or 0 to probe before every capture */
+
+} OS_PACK VC0706_SetProbeIdleCmd_t;
+
+/**
+ * Switches thumbnail previews on or off. With them on, each image's thumbnail is announced to TIM before the image.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint8 Enable;                         /**< 1 to make thumbnails, 0 to stop */
+
+} OS_PACK VC0706_SetThumbnailsCmd_t;
+
+/**
+ * Sets how close a frame may be to its camera's last kept frame before it's dropped as a repeat.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint8 Distance;                       /**< Most signature cells (of 256) that may change in a repeat, or 0 to keep every frame */
+
+} OS_PACK VC0706_SetDedupCmd_t;
+
+/**
+ * Sets the quota the stored images and their sidecar files are kept within. Images are evicted to make room.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint32 MaxBytes;                      /**< Most bytes the images may take up. Must fit at least one largest frame. */
+    uint16 MaxImages;                     /**< Most images that may be stored, 1 to VC0706_CATALOG_MAX_ENTRIES */
+
+} OS_PACK VC0706_SetStoreQuotaCmd_t;
+
+/**
+ * Sets a stored image's downlink status and priority. Downlinked images are evicted first, then the lowest priority.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE];    /**< The header of the command packet */
+    char ImageName[VC0706_MAX_FILENAME_LEN]; /**< The image's name, as reported in housekeeping and sent to TIM */
+    uint8 Downlinked;                        /**< 1 if ground has the image, 0 if not */
+    uint8 Priority;                          /**< The image's priority; see the VC0706_PRIORITY_ values */
+
+} OS_PACK VC0706_SetImageStatusCmd_t;
+
+/**
+ * Chooses how frames are stored. Switching back to files seals each camera's open segment as its next frame arrives.
+ */
+typedef struct
+{
+    uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the command packet */
+    uint8 Format;                         /**< VC0706_FORMAT_FILES or VC0706_FORMAT_SEGMENTS */
+
+} OS_PACK VC0706_SetStorageFormatCmd_t;
+
 /**
  * A VC0706 housekeeping telemetry packet
  */
@@ -36,11 +240,108 @@ typedef struct
     uint8 vc0706_command_error_count;              /**< The amount of VC0706 command errors to report */
     uint8 vc0706_command_count;                    /**< The amount of VC0706 commands issued */
     char vc0706_filename[VC0706_MAX_FILENAME_LEN]; /**< The filename of the picture taken by the VC0706 application */
+    uint32 vc0706_baud[VC0706_MAX_CAMERAS];        /**< The baud rate each camera link is running at */
+    uint32 vc0706_baud_history[VC0706_MAX_CAMERAS][VC0706_BAUD_HISTORY_LEN]; /**< Rates chosen by recent baud negotiations, newest first */
+    uint8 vc0706_baud_fallbacks[VC0706_MAX_CAMERAS]; /**< Number of baud rates that failed their link check */
+    uint8 vc0706_camera_count;                     /**< Number of cameras the app is set to drive */
+    uint8 vc0706_capture_mode;                     /**< One of the VC0706_MODE_ values */
+    uint16 vc0706_motion_window_ms;                /**< Motion alerts within this window count toward a trigger */
+    uint8 vc0706_motion_sensitivity;               /**< Motion alerts needed within the window to trigger a capture */
+    uint32 vc0706_motion_alerts;                   /**< Motion-detected frames received from the cameras */
+    uint32 vc0706_motion_captures;                 /**< Captures triggered by motion */
+    uint8 vc0706_image_size;                       /**< Resolution code the cameras are set to */
+    uint8 vc0706_downsize;                         /**< Downsize level the cameras are set to */
+    uint32 vc0706_size_target;                     /**< Frame size the compression controller aims for, 0 if disabled */
+    uint8 vc0706_compression[VC0706_MAX_CAMERAS];  /**< Compression ratio each camera is set to */
+    uint32 vc0706_last_frame_len[VC0706_MAX_CAMERAS]; /**< Length of each camera's last frame */
+    uint32 vc0706_sync_skew_us;                    /**< Time between the first and last camera's freeze command in the last capture */
+    uint32 vc0706_sync_skew_max_us;                /**< Largest freeze skew seen since the counters were reset */
+    uint32 vc0706_period_ms;                       /**< Capture period used in VC0706_MODE_PERIODIC */
+    uint32 vc0706_triggers;                        /**< Captures started by a period, wakeup or burst */
+    uint32 vc0706_trigger_jitter_ms;               /**< How late the last scheduled capture started */
+    uint32 vc0706_trigger_jitter_max_ms;           /**< Latest a scheduled capture has started since the counters were reset */
+    uint32 vc0706_missed_deadlines;                /**< Periods or wakeups that passed without a capture */
+    uint32 vc0706_plan_captures;                   /**< Capture plan entries carried out */
+    uint32 vc0706_plan_missed;                     /**< Capture plan entries dropped for being too far overdue */
+    uint32 vc0706_plan_latency_ms;                 /**< How late the last plan entry started after its time */
+    uint32 vc0706_plan_latency_max_ms;             /**< Latest a plan entry has started since the counters were reset */
+    uint8 vc0706_retry_budget;                     /**< Chunk re-requests allowed per frame */
+    uint8 vc0706_retry_policy;                     /**< VC0706_RETRY_GIVE_UP or VC0706_RETRY_RECAPTURE */
+    uint32 vc0706_probe_idle_ms;                   /**< Idle time after which a camera is probed before capturing */
+    uint8 vc0706_thumbnails;                       /**< Whether thumbnails are being made */
+    uint8 vc0706_dedup_distance;                   /**< Most signature cells a frame may change and still be dropped as a repeat, 0 if off */
+    uint32 vc0706_store_quota_bytes;               /**< Most bytes the stored images may take up */
+    uint16 vc0706_store_quota_images;              /**< Most images that may be stored */
+    uint32 vc0706_store_bytes;                     /**< Bytes the stored images and their sidecar files take up */
+    uint16 vc0706_store_images;                    /**< Number of images stored */
+    uint8 vc0706_storage_format;                   /**< VC0706_FORMAT_FILES or VC0706_FORMAT_SEGMENTS */
+    uint32 vc0706_phase_p50_us[VC0706_PHASE_COUNT]; /**< Median time of each capture phase over recent samples */
+    uint32 vc0706_phase_p90_us[VC0706_PHASE_COUNT]; /**< 90th percentile time of each capture phase */
+    uint32 vc0706_phase_p99_us[VC0706_PHASE_COUNT]; /**< 99th percentile time of each capture phase */
+    uint32 vc0706_phase_max_us[VC0706_PHASE_COUNT]; /**< Slowest recent time of each capture phase */
 
 } OS_PACK vc0706_hk_tlm_t;
 
 #define VC0706_HK_TLM_LNGTH sizeof(vc0706_hk_tlm_t)
 
+/*
+** Camera commands whose reply failures are counted separately (indexes of the vc0706_reply_ arrays)
+*/
+#define VC0706_CMDSTAT_WRITE_DATA 0 /* WRITE_DATA (image size, compression) */
+#define VC0706_CMDSTAT_DOWNSIZE 1   /* DOWNSIZE_CTRL */
+#define VC0706_CMDSTAT_VERSION 2    /* GEN_VERSION */
+#define VC0706_CMDSTAT_FBUF_CTRL 3  /* FBUF_CTRL (freeze, resume) */
+#define VC0706_CMDSTAT_FBUF_LEN 4   /* GET_FBUF_LEN */
+#define VC0706_CMDSTAT_READ_FBUF 5  /* READ_FBUF header or tail */
+#define VC0706_CMDSTAT_SET_PORT 6   /* SET_PORT */
+#define VC0706_CMDSTAT_RESET 7      /* RESET */
+#define VC0706_CMDSTAT_OTHER 8      /* Anything else */
+#define VC0706_CMDSTAT_COUNT 9
+
+/** Number of capture latency histogram buckets. Upper bounds in ms: 250, 500, 1000, 2000, 4000, 8000, 16000, above. */
+#define VC0706_LATENCY_BUCKETS 8
+/** Number of image size histogram buckets. Upper bounds in KiB: 2, 4, 8, 16, 32, 64, 128, above. */
+#define VC0706_SIZE_BUCKETS 8
+
+/**
+ * VC0706 capture performance telemetry packet, sent alongside housekeeping
+ */
+typedef struct
+{
+    uint8 TlmHeader[CFE_SB_TLM_HDR_SIZE];                  /**< The header of the packet */
+    uint32 vc0706_frames_captured;                         /**< Frames downloaded and handed to storage */
+    uint32 vc0706_frames_failed;                           /**< Captures that were started but produced no image */
+    uint64 vc0706_bytes_transferred;                       /**< Image bytes downloaded from the cameras */
+    uint64 vc0706_download_ms;                             /**< Time spent downloading those bytes */
+    uint32 vc0706_throughput_avg_bps;                      /**< Average download rate in bytes per second */
+    uint32 vc0706_throughput_peak_bps;                     /**< Fastest single-frame download rate in bytes per second */
+    uint32 vc0706_reply_errors[VC0706_CMDSTAT_COUNT];      /**< Replies that arrived malformed, by command */
+    uint32 vc0706_reply_timeouts[VC0706_CMDSTAT_COUNT];    /**< Replies that didn't arrive in time, by command */
+    uint32 vc0706_resync_bytes;                            /**< Bytes skipped while looking for the start of a reply */
+    uint32 vc0706_chunk_retries;                           /**< READ_FBUF chunks re-requested after failing */
+    uint64 vc0706_bytes_resumed;                           /**< Bytes already stored when a chunk was retried, so not downloaded again */
+    uint32 vc0706_retries_exhausted;                       /**< Frames abandoned with their retry budget spent */
+    uint32 vc0706_recaptures;                              /**< Captures retaken under VC0706_RETRY_RECAPTURE */
+    uint32 vc0706_probes;                                  /**< GEN_VERSION liveness probes sent ahead of captures */
+    uint32 vc0706_probes_skipped;                          /**< Captures that went ahead without a probe, the camera being recently alive */
+    uint32 vc0706_probe_failures;                          /**< Probes that went unanswered or were refused */
+    uint32 vc0706_frames_invalid;                          /**< Downloaded frames thrown away for failing the JPEG check */
+    uint32 vc0706_last_crc;                                /**< CRC32 of the last image stored */
+    uint32 vc0706_thumbs_made;                             /**< Thumbnails written and announced */
+    uint32 vc0706_thumbs_failed;                           /**< Images announced without a thumbnail */
+    uint32 vc0706_thumb_bytes;                             /**< Total size of the thumbnails written */
+    uint32 vc0706_frames_repeated;                         /**< Frames deleted for being nearly the same as the last one kept */
+    uint32 vc0706_last_distance;                           /**< Signature cells that changed between the last frame checked and its camera's last kept frame */
+    uint32 vc0706_images_evicted;                          /**< Stored images deleted to keep within the store quota */
+    uint32 vc0706_images_refused;                          /**< Frames not stored because nothing could be evicted to make room */
+    uint32 vc0706_segments_sealed;                         /**< Segments closed and announced to TIM */
+    uint32 vc0706_latency_hist[VC0706_LATENCY_BUCKETS];    /**< Captures by time from start to last chunk stored */
+    uint32 vc0706_size_hist[VC0706_SIZE_BUCKETS];          /**< Captures by image size */
+
+} OS_PACK vc0706_capture_tlm_t;
+
+#define VC0706_CAPTURE_TLM_LNGTH sizeof(vc0706_capture_tlm_t)
+
 /*************************************************************************/
 /*
 ** Definitions redundantly copied from TIM
@@ -58,7 +359,8 @@ typedef struct
 {
     uint8 CmdHeader[CFE_SB_CMD_HDR_SIZE]; /**< The header of the packet */
     char ImageName[VC0706_MAX_IMAGE_NAME_LEN]; /**< The name of the saved image */
-} VC0706_IMAGE_CMD_PKT_t;
+    uint32 ImageCrc;                      /**< CRC32 (IEEE 802.3) of the whole image file, or 0 for error.txt */
+} OS_PACK VC0706_IMAGE_CMD_PKT_t;
 
 #define VC0706_IMAGE_CMD_LNGTH sizeof(VC0706_IMAGE_CMD_PKT_t)
 
@@ -0,0 +1,136 @@
+/**
+ * \file vc0706_parser.c
+ * \brief Incremental framing of VC0706 replies over a per-camera receive ring
+ *
+ * Bytes are read from the camera into its receive ring in whatever pieces they arrive, and replies are framed out of
+ * the ring as they complete. The parser looks for the 0x76 reply marker, checks the serial number and command against
+ * the reply expected, and skips anything else a byte at a time until it finds one, so line noise or a stale reply
+ * costs a few bytes rather than the whole capture. Motion-detected frames the camera sends on its own are taken out
+ * of the stream wherever they turn up and counted for the motion trigger.
+ */
+#include "vc0706_parser.h"
+#include "vc0706_child.h"
+
+/**
+ * Gives the byte offset bytes into the unparsed data.
+ */
+static uint8_t rxPeek(const VC0706_RxRing_t *rx, uint16 offset)
+{
+    return rx->buf[(rx->head + offset) & (VC0706_RX_RING_SIZE - 1)];
+}
+
+/**
+ * Drops bytes from the front of the unparsed data.
+ */
+static void rxSkip(VC0706_RxRing_t *rx, uint16 len)
+{
+    rx->head = (uint16)((rx->head + len) & (VC0706_RX_RING_SIZE - 1));
+    rx->count = (uint16)(rx->count - len);
+}
+
+/**
+ * Empties the ring, e.g. after the line has been drained. Uncollected motion alerts are kept.
+ */
+void rxReset(VC0706_RxRing_t *rx)
+{
+    rx->head = 0;
+    rx->count = 0;
+}
+
+/**
+ * Reads whatever the camera has sent into the ring, up to the space left.
+ * \param fd - The camera's file descriptor. Should be non-blocking or known to be readable.
+ * \returns The number of bytes read, 0 if nothing was waiting or the ring is full, or -1 if the port failed
+ */
+int rxFill(VC0706_RxRing_t *rx, int fd)
+{
+    uint16 tail = (uint16)((rx->head + rx->count) & (VC0706_RX_RING_SIZE - 1));
+    uint16 space = (uint16)(VC0706_RX_RING_SIZE - rx->count);
+
+    // Only read up to the wrap point; the next call picks up the rest
+    uint16 contiguous = (uint16)(VC0706_RX_RING_SIZE - tail);
+    if (space > contiguous)
+        space = contiguous;
+    if (space == 0)
+        return 0;
+
+    ssize_t got = read(fd, &rx->buf[tail], space);
+    if (got < 0)
+        return errno == EAGAIN || errno == EINTR ? 0 : -1;
+    rx->count = (uint16)(rx->count + got);
+    return (int)got;
+}
+
+/**
+ * Moves already-received bytes out of the ring, e.g. the start of a payload that arrived with its header.
+ * \param[out] dest - Where to copy the bytes
+ * \param len - The most bytes wanted
+ * \returns The number of bytes copied
+ */
+uint32 rxTake(VC0706_RxRing_t *rx, uint8_t *dest, uint32 len)
+{
+    uint32 taken = 0;
+
+    while (taken < len && rx->count > 0)
+    {
+        uint16 contiguous = (uint16)(VC0706_RX_RING_SIZE - rx->head);
+        uint32 n = len - taken;
+        if (n > rx->count)
+            n = rx->count;
+        if (n > contiguous)
+            n = contiguous;
+        memcpy(dest + taken, &rx->buf[rx->head], n);
+        rxSkip(rx, (uint16)n);
+        taken += n;
+    }
+    return taken;
+}
+
+/**
+ * Frames the next reply out of the ring. Motion-detected frames are counted in rx->motionAlerts and skipped, and
+ * bytes that can't start the expected reply are discarded.
+ * \param expect - The reply being waited for, or NULL to only pick out motion alerts
+ * \param[out] hdr - The reply header, on VC0706_PARSE_REPLY or VC0706_PARSE_ERROR
+ * \returns One of VC0706_ParseResult_t
+ */
+uint8 rxNextReply(VC0706_RxRing_t *rx, const VC0706_Reply_t *expect, uint8_t hdr[VC0706_REPLY_HEADER_LEN])
+{
+    int i;
+
+    while (rx->count > 0)
+    {
+        if (rxPeek(rx, 0) != COMMAND_SUCCESS)
+        {
+            rxSkip(rx, 1);
+            VC0706_CaptureTlmPkt.vc0706_resync_bytes++;
+            continue;
+        }
+        if (rx->count < VC0706_REPLY_HEADER_LEN)
+            return VC0706_PARSE_MORE;
+
+        uint8_t serial = rxPeek(rx, 1);
+        uint8_t cmd = rxPeek(rx, 2);
+        uint8_t status = rxPeek(rx, 3);
+        bool ours = expect != NULL && expect->cmd != 0 && serial == expect->serial && cmd == expect->cmd;
+
+        if (!ours && cmd == COMM_MOTION_DETECTED && status == 0x00 && rxPeek(rx, 4) == 0x00)
+        {
+            rxSkip(rx, VC0706_REPLY_HEADER_LEN);
+            rx->motionAlerts++;
+            continue;
+        }
+
+        if (ours)
+        {
+            for (i = 0; i < VC0706_REPLY_HEADER_LEN; i++)
+                hdr[i] = rxPeek(rx, (uint16)i);
+            rxSkip(rx, VC0706_REPLY_HEADER_LEN);
+            return replyMatches(expect, hdr) ? VC0706_PARSE_REPLY : VC0706_PARSE_ERROR;
+        }
+
+        // Not the start of anything we want; look for the next marker
+        rxSkip(rx, 1);
+        VC0706_CaptureTlmPkt.vc0706_resync_bytes++;
+    }
+    return VC0706_PARSE_MORE;
+}
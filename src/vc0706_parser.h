@@ -0,0 +1,25 @@
+/**
+ * \file vc0706_parser.h
+ * \brief Header for incremental framing of VC0706 replies
+ */
+#ifndef _vc0706_parser_h_
+#define _vc0706_parser_h_
+
+#include "vc0706.h"
+
+/**
+ * Outcomes of looking for a reply in a camera's receive ring
+ */
+typedef enum
+{
+    VC0706_PARSE_MORE,  /**< No complete reply yet; read more bytes */
+    VC0706_PARSE_REPLY, /**< The expected reply header was found and consumed */
+    VC0706_PARSE_ERROR  /**< The camera answered the command with a failure status */
+} VC0706_ParseResult_t;
+
+void rxReset(VC0706_RxRing_t *rx);
+int rxFill(VC0706_RxRing_t *rx, int fd);
+uint32 rxTake(VC0706_RxRing_t *rx, uint8_t *dest, uint32 len);
+uint8 rxNextReply(VC0706_RxRing_t *rx, const VC0706_Reply_t *expect, uint8_t hdr[VC0706_REPLY_HEADER_LEN]);
+
+#endif
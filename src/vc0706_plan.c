@@ -0,0 +1,188 @@
+/**
+ * \file vc0706_plan.c
+ * \brief Carries out the time-tagged capture plan
+ *
+ * The plan is a cFE table of absolute-time captures, each with its own resolution, compression and burst count. The
+ * main task registers and manages the table, so ground can load and activate a new plan through Table Services at
+ * any time. The capture task polls the plan between captures and carries out each entry as its time comes up, taking
+ * precedence over the capture mode.
+ */
+#include "vc0706_plan.h"
+#include "vc0706_child.h"
+#include "vc0706_sched.h"
+
+/** Table Services handle for the plan */
+static CFE_TBL_Handle_t VC0706_PlanHandle;
+/** Time (ms) of the last entry carried out or dropped. Entries at or before this are done. */
+static uint64_t VC0706_PlanDoneMs = 0;
+/** The entry currently being carried out */
+static VC0706_PlanEntry_t VC0706_PlanActive;
+/** Captures still owed to VC0706_PlanActive */
+static uint16 VC0706_PlanShotsLeft = 0;
+/** Whether VC0706_PlanActive holds an entry in progress */
+static bool VC0706_PlanBusy = false;
+
+/**
+ * Converts a CFE time to milliseconds
+ */
+static uint64_t timeMs(uint32 seconds, uint32 subseconds)
+{
+    return (uint64_t)seconds * 1000 + CFE_TIME_Sub2MicroSecs(subseconds) / 1000;
+}
+
+/**
+ * Table Services validation function. Rejects plans with settings the cameras can't take.
+ * \returns CFE_SUCCESS if the plan is valid, -1 otherwise
+ */
+static int32 VC0706_PlanValidate(void *tbl)
+{
+    VC0706_PlanTbl_t *plan = (VC0706_PlanTbl_t *)tbl;
+    int i;
+
+    for (i = 0; i < VC0706_PLAN_MAX_ENTRIES; i++)
+    {
+        VC0706_PlanEntry_t *e = &plan->Entries[i];
+        if (e->BurstCount == 0)
+            continue;
+
+        bool sizeValid = e->ImageSize == SIZE640 || e->ImageSize == SIZE320 || e->ImageSize == SIZE160;
+        bool downsizeValid = e->Downsize == DOWNSIZE_NONE || e->Downsize == DOWNSIZE_HALF || e->Downsize == DOWNSIZE_QUARTER;
+        bool compressionValid = e->Compression == 0 || e->Compression >= VC0706_MIN_COMPRESSION;
+        if (e->BurstCount > VC0706_MAX_BURST || !sizeValid || !downsizeValid || !compressionValid)
+        {
+            CFE_EVS_SendEvent(VC0706_PLAN_ERR_EID, CFE_EVS_ERROR,
+                              "VC0706: plan entry %d invalid: burst %d size 0x%02x downsize 0x%02x compression 0x%02x",
+                              i, e->BurstCount, e->ImageSize, e->Downsize, e->Compression);
+            return -1;
+        }
+    }
+    return CFE_SUCCESS;
+}
+
+/**
+ * Registers the plan table and loads the startup plan. An empty plan is used if the file can't be loaded.
+ * Runs in the main task.
+ * \returns CFE_SUCCESS, or the Table Services error code
+ */
+int32 VC0706_PlanInit(void)
+{
+    static const VC0706_PlanTbl_t empty; // all entries unused
+
+    int32 result = CFE_TBL_Register(&VC0706_PlanHandle, VC0706_PLAN_TBL_NAME, sizeof(VC0706_PlanTbl_t),
+                                    CFE_TBL_OPT_DEFAULT, VC0706_PlanValidate);
+    if (result != CFE_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_PLAN_ERR_EID, CFE_EVS_ERROR, "VC0706: plan table register failed: result = %d", (int)result);
+        return result;
+    }
+
+    if (CFE_TBL_Load(VC0706_PlanHandle, CFE_TBL_SRC_FILE, VC0706_PLAN_TBL_FILE) != CFE_SUCCESS)
+        result = CFE_TBL_Load(VC0706_PlanHandle, CFE_TBL_SRC_ADDRESS, &empty);
+    return result;
+}
+
+/**
+ * Lets Table Services validate and activate a newly loaded plan. Runs in the main task on every housekeeping request.
+ */
+void VC0706_PlanManage(void)
+{
+    CFE_TBL_Manage(VC0706_PlanHandle);
+}
+
+/**
+ * Checks the plan for a capture that is due. Runs in the capture task.
+ * \param waitMs - Set to how long until the next entry is due, if nothing is due now. Capped at VC0706_SCHED_POLL_MS.
+ * \returns true if a planned capture should be taken now
+ */
+bool VC0706_PlanNext(uint32 *waitMs)
+{
+    VC0706_PlanTbl_t *plan;
+    int i;
+
+    *waitMs = VC0706_SCHED_POLL_MS;
+
+    // Finish the burst we're in the middle of first
+    if (VC0706_PlanShotsLeft > 0)
+    {
+        VC0706_PlanShotsLeft--;
+        return true;
+    }
+    VC0706_PlanBusy = false;
+
+    int32 result = CFE_TBL_GetAddress((void **)&plan, VC0706_PlanHandle);
+    if (result == CFE_TBL_INFO_UPDATED)
+        CFE_EVS_SendEvent(VC0706_PLAN_INF_EID, CFE_EVS_INFORMATION, "VC0706: new capture plan active");
+    else if (result != CFE_SUCCESS)
+        return false;
+
+    CFE_TIME_SysTime_t sysNow = CFE_TIME_GetTime();
+    uint64_t now = timeMs(sysNow.Seconds, sysNow.Subseconds);
+    uint64_t dropped = VC0706_PlanDoneMs;
+    uint64_t nextMs = 0;
+    int due = -1;
+    uint64_t dueMs = 0;
+
+    for (i = 0; i < VC0706_PLAN_MAX_ENTRIES; i++)
+    {
+        VC0706_PlanEntry_t *e = &plan->Entries[i];
+        if (e->BurstCount == 0)
+            continue;
+
+        uint64_t t = timeMs(e->Seconds, e->Subseconds);
+        if (t <= VC0706_PlanDoneMs)
+            continue; // already carried out or dropped
+
+        if (t > now)
+        {
+            if (nextMs == 0 || t < nextMs)
+                nextMs = t;
+        }
+        else if (now - t > VC0706_PLAN_LATE_LIMIT_MS)
+        {
+            // Too late to be worth taking, e.g. the task was stalled or the plan was loaded after the fact
+            VC0706_HkTelemetryPkt.vc0706_plan_missed++;
+            if (t > dropped)
+                dropped = t;
+        }
+        else if (due == -1 || t < dueMs)
+        {
+            due = i;
+            dueMs = t;
+        }
+    }
+    VC0706_PlanDoneMs = dropped;
+
+    if (due != -1)
+    {
+        VC0706_PlanActive = plan->Entries[due];
+        VC0706_PlanShotsLeft = VC0706_PlanActive.BurstCount - 1;
+        VC0706_PlanBusy = true;
+        VC0706_PlanDoneMs = dueMs;
+    }
+    CFE_TBL_ReleaseAddress(VC0706_PlanHandle);
+
+    if (due == -1)
+    {
+        if (nextMs != 0 && nextMs - now < *waitMs)
+            *waitMs = (uint32)(nextMs - now);
+        return false;
+    }
+
+    uint32 latency = (uint32)(now - dueMs);
+    VC0706_HkTelemetryPkt.vc0706_plan_latency_ms = latency;
+    if (latency > VC0706_HkTelemetryPkt.vc0706_plan_latency_max_ms)
+        VC0706_HkTelemetryPkt.vc0706_plan_latency_max_ms = latency;
+    VC0706_HkTelemetryPkt.vc0706_plan_captures++;
+    CFE_EVS_SendEvent(VC0706_PLAN_INF_EID, CFE_EVS_INFORMATION, "VC0706: plan entry %d started %u ms after its time",
+                      due, (unsigned int)latency);
+    return true;
+}
+
+/**
+ * Gives the plan entry whose captures are being taken, so its settings can override the ground-set ones.
+ * \returns The entry, or NULL if the current capture isn't a planned one
+ */
+const VC0706_PlanEntry_t *VC0706_PlanCurrent(void)
+{
+    return VC0706_PlanBusy ? &VC0706_PlanActive : (const VC0706_PlanEntry_t *)NULL;
+}
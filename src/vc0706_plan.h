@@ -0,0 +1,45 @@
+/**
+ * \file vc0706_plan.h
+ * \brief Header for the VC0706 time-tagged capture plan table
+ */
+#ifndef _vc0706_plan_h_
+#define _vc0706_plan_h_
+
+#include "vc0706.h"
+
+/** Most entries one capture plan can hold */
+#define VC0706_PLAN_MAX_ENTRIES 32
+/** Name the plan is registered under with Table Services */
+#define VC0706_PLAN_TBL_NAME "PlanTbl"
+/** Plan loaded at startup, if present */
+#define VC0706_PLAN_TBL_FILE "/cf/vc0706_plan.tbl"
+/** Entries that are more than this many milliseconds overdue are dropped as missed instead of carried out */
+#define VC0706_PLAN_LATE_LIMIT_MS 10000
+
+/**
+ * One planned capture. An entry with a BurstCount of 0 is unused.
+ */
+typedef struct
+{
+    uint32 Seconds;    /**< Spacecraft time (CFE_TIME) of the capture, seconds */
+    uint32 Subseconds; /**< Spacecraft time (CFE_TIME) of the capture, subseconds */
+    uint8 BurstCount;  /**< Number of captures to take, 1 to VC0706_MAX_BURST, or 0 if the entry is unused */
+    uint8 ImageSize;   /**< SIZE640, SIZE320 or SIZE160. A size other than the cameras' current one costs a reset. */
+    uint8 Downsize;    /**< DOWNSIZE_NONE, DOWNSIZE_HALF or DOWNSIZE_QUARTER */
+    uint8 Compression; /**< Compression ratio to use, or 0 to leave it to the compression controller */
+} VC0706_PlanEntry_t;
+
+/**
+ * The capture plan table. Entries need not be sorted, but no two should share a time.
+ */
+typedef struct
+{
+    VC0706_PlanEntry_t Entries[VC0706_PLAN_MAX_ENTRIES]; /**< The planned captures */
+} VC0706_PlanTbl_t;
+
+int32 VC0706_PlanInit(void);
+void VC0706_PlanManage(void);
+bool VC0706_PlanNext(uint32 *waitMs);
+const VC0706_PlanEntry_t *VC0706_PlanCurrent(void);
+
+#endif
@@ -0,0 +1,18 @@
+/**
+ * \file vc0706_plan_tbl.c
+ * \brief Default capture plan table image (/cf/vc0706_plan.tbl)
+ *
+ * Built into a table file by the mission's table tools rather than linked into the app. The default plan is empty;
+ * fill in entries and load the resulting file through Table Services to plan captures.
+ */
+#include "cfe_tbl_filedef.h"
+#include "vc0706_plan.h"
+
+VC0706_PlanTbl_t VC0706_PlanTbl =
+    {
+        {
+            /* Seconds, Subseconds, BurstCount, ImageSize, Downsize, Compression */
+            {0, 0, 0, SIZE640, DOWNSIZE_NONE, 0},
+        }};
+
+CFE_TBL_FILEDEF(VC0706_PlanTbl, VC0706.PlanTbl, VC0706 time-tagged capture plan, vc0706_plan.tbl)
@@ -0,0 +1,833 @@
+/**
+ * \file vc0706_reactor.c
+ * \brief Event-driven capture engine that multiplexes every camera from one task
+ *
+ * One task owns every camera's file descriptor and waits on all of them with epoll. Each camera runs its own
+ * non-blocking state machine through the capture sequence (probe when due, freeze, length, chunked read, resume), so adding a
+ * camera costs a VC0706_Xfer_t rather than a task and its stack, and a slow camera never holds up the others' bytes.
+ */
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include "vc0706_reactor.h"
+#include "vc0706_child.h"
+#include "vc0706_parser.h"
+#include "vc0706_plan.h"
+#include "vc0706_sched.h"
+#include "vc0706_serial.h"
+#include "vc0706_storage.h"
+#include "vc0706_timing.h"
+
+// External References
+extern struct led_t led; /**< LED instance from vc0706.c */
+extern struct Camera_t cams[VC0706_MAX_CAMERAS];
+
+/** The epoll instance watching every camera */
+static int VC0706_Epoll = -1;
+/** One capture state machine per camera */
+static VC0706_Xfer_t VC0706_Xfers[VC0706_MAX_CAMERAS];
+/** When the LED was switched on for the current capture, or 0 if it is off */
+static uint64_t VC0706_LedOnMs = 0;
+
+/**
+ * Creates the epoll instance and resets every camera's state machine.
+ * \returns 0 on success, -1 on failure
+ */
+int VC0706_ReactorInit(void)
+{
+    int i;
+
+    VC0706_Epoll = epoll_create1(0);
+    if (VC0706_Epoll < 0)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "Reactor init error: epoll_create1 failed: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(VC0706_Xfers, 0, sizeof(VC0706_Xfers));
+    for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+    {
+        VC0706_Xfers[i].cam = &cams[i];
+        VC0706_Xfers[i].state = VC0706_XFER_IDLE;
+    }
+    return 0;
+}
+
+/**
+ * Makes sure a camera's current fd is non-blocking and in the epoll set. Reopening the port (e.g. after a baud change)
+ * drops the old fd from the set, so this is done at the start of every capture.
+ */
+static int watchCamera(int index)
+{
+    Camera_t *cam = VC0706_Xfers[index].cam;
+    struct epoll_event ev;
+
+    int flags = fcntl(cam->fd, F_GETFL);
+    if (flags >= 0)
+        fcntl(cam->fd, F_SETFL, flags | O_NONBLOCK);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32)index;
+    if (epoll_ctl(VC0706_Epoll, EPOLL_CTL_ADD, cam->fd, &ev) < 0 && errno != EEXIST)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "Camera %d could not be watched: %s", index, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/** Performance log ID for each step, in VC0706_XferStep_t order */
+static const uint32 VC0706_StepPerfIds[] = {
+    VC0706_SETTINGS_PERF_ID, VC0706_SETTINGS_PERF_ID, VC0706_VERSION_PERF_ID,
+    VC0706_FREEZE_PERF_ID, VC0706_LENGTH_PERF_ID, VC0706_CHUNK_PERF_ID, VC0706_RESUME_PERF_ID,
+};
+
+/**
+ * Marks the start of the current step in the cFE performance log.
+ */
+static void stepPerfEntry(VC0706_Xfer_t *x)
+{
+    CFE_ES_PerfLogEntry(VC0706_StepPerfIds[x->step]);
+    x->perfOpen = true;
+}
+
+/**
+ * Marks the end of the current step in the cFE performance log, if its start was marked.
+ */
+static void stepPerfExit(VC0706_Xfer_t *x)
+{
+    if (x->perfOpen)
+        CFE_ES_PerfLogExit(VC0706_StepPerfIds[x->step]);
+    x->perfOpen = false;
+}
+
+/**
+ * Picks the first setting that the camera doesn't hold yet, or the version probe once they all match.
+ */
+static uint8 nextSetupStep(VC0706_Xfer_t *x)
+{
+    Camera_t *cam = x->cam;
+
+    if (cam->downsize != cam->downsizeApplied)
+        return VC0706_STEP_DOWNSIZE;
+    if (x->compression != cam->compressionApplied)
+        return VC0706_STEP_COMPRESS;
+    return VC0706_STEP_VERSION;
+}
+
+/**
+ * Decides whether a camera needs an explicit liveness probe before it's frozen. Any reply that checks out proves the
+ * camera is alive, so the GEN_VERSION round trip is only spent after a failure or once the camera has been quiet for
+ * VC0706_Config.probeIdleMs.
+ */
+static bool probeDue(VC0706_Xfer_t *x)
+{
+    return x->suspect || VC0706_Config.probeIdleMs == 0 || monotonicMs() - x->aliveMs >= VC0706_Config.probeIdleMs;
+}
+
+static void sendStep(VC0706_Xfer_t *x, uint8 step);
+
+/**
+ * Moves a camera on to its next setting, its probe, or straight to the sync point if it needs neither.
+ */
+static void continueSetup(VC0706_Xfer_t *x)
+{
+    uint8 step = nextSetupStep(x);
+
+    if (step == VC0706_STEP_VERSION && !probeDue(x))
+    {
+        VC0706_CaptureTlmPkt.vc0706_probes_skipped++;
+        VC0706_TimingRecord(VC0706_PHASE_SETUP, monotonicUs() - x->frameUs);
+        x->step = VC0706_STEP_VERSION;
+        x->state = VC0706_XFER_SYNC_WAIT;
+        return;
+    }
+
+    if (step == VC0706_STEP_VERSION)
+        VC0706_CaptureTlmPkt.vc0706_probes++;
+    sendStep(x, step);
+}
+
+/**
+ * Sends the command for a step and starts waiting for its reply.
+ */
+static void sendStep(VC0706_Xfer_t *x, uint8 step)
+{
+    Camera_t *cam = x->cam;
+
+    x->step = step;
+
+    switch (step)
+    {
+    case VC0706_STEP_DOWNSIZE:
+    {
+        uint8_t downsizeArgs[] = {0x01, cam->downsize};
+        x->expect = sendCommand(cam, DOWNSIZE_CTRL, downsizeArgs, sizeof(downsizeArgs));
+        break;
+    }
+    case VC0706_STEP_COMPRESS:
+    {
+        uint8_t writeDataArgs[6];
+        compressionArgs(writeDataArgs, x->compression);
+        x->expect = sendCommand(cam, WRITE_DATA, writeDataArgs, sizeof(writeDataArgs));
+        break;
+    }
+    case VC0706_STEP_VERSION:
+    {
+        uint8_t genVersionArgs[] = {0x00};
+        x->expect = sendCommand(cam, GEN_VERSION, genVersionArgs, sizeof(genVersionArgs));
+        break;
+    }
+    case VC0706_STEP_FREEZE:
+    {
+        uint8_t frameBufferControlArgs[] = {0x01, STOPCURRENTFRAME};
+        x->expect = sendCommand(cam, FBUF_CTRL, frameBufferControlArgs, sizeof(frameBufferControlArgs));
+        break;
+    }
+    case VC0706_STEP_LENGTH:
+    {
+        uint8_t getFrameBufferLengthArgs[] = {0x01, 0x00};
+        x->expect = sendCommand(cam, GET_FBUF_LEN, getFrameBufferLengthArgs, sizeof(getFrameBufferLengthArgs));
+        break;
+    }
+    case VC0706_STEP_READ:
+        x->expect = requestChunk(cam, cam->frameptr, x->chunk);
+        break;
+    case VC0706_STEP_RESUME:
+    default:
+    {
+        uint8_t frameBufferControlArgs[] = {0x01, RESUMEFRAME};
+        x->expect = sendCommand(cam, FBUF_CTRL, frameBufferControlArgs, sizeof(frameBufferControlArgs));
+        break;
+    }
+    }
+
+    // Only fixed-size reply data is collected; READ_FBUF payloads land in the ring instead
+    x->dataWant = x->expect.dataLen == VC0706_REPLY_DATA_VARIABLE || x->expect.tail ? 0 : x->expect.dataLen;
+    x->state = VC0706_XFER_CMD_SENT;
+    x->dataLen = 0;
+    x->deadline = monotonicMs() + wireTimeMs(cam, VC0706_REPLY_HEADER_LEN + x->dataWant);
+    x->phaseUs = monotonicUs();
+    stepPerfEntry(x);
+}
+
+/**
+ * Ends a camera's capture early. Throws away any partial image and lets the camera's video run again.
+ */
+static void failXfer(VC0706_Xfer_t *x, const char *why)
+{
+    Camera_t *cam = x->cam;
+
+    stepPerfExit(x);
+
+    // A resume that goes unanswered doesn't spoil an image that's already stored
+    if (x->step == VC0706_STEP_RESUME)
+    {
+        x->state = VC0706_XFER_IDLE;
+        return;
+    }
+
+    // Have the camera proved alive before it's trusted with another frame
+    if (x->step == VC0706_STEP_VERSION)
+        VC0706_CaptureTlmPkt.vc0706_probe_failures++;
+    x->suspect = true;
+
+    OS_printf("VC0706: Camera %d capture failed during step %d: %s\n", cam->ttyInterface, x->step, why);
+
+    if (x->storing)
+        VC0706_StorageEnd(cam->ttyInterface, false);
+    x->storing = false;
+
+    // Fire and forget; whatever the camera sends back is drained before the next capture. A freeze whose reply was
+    // lost may still have frozen the buffer, so it gets resumed too.
+    if (x->step >= VC0706_STEP_FREEZE)
+    {
+        uint8_t frameBufferControlArgs[] = {0x01, RESUMEFRAME};
+        sendCommand(cam, FBUF_CTRL, frameBufferControlArgs, sizeof(frameBufferControlArgs));
+    }
+
+    x->state = VC0706_XFER_IDLE;
+}
+
+/**
+ * Re-requests the part of the frame that hasn't been stored yet, once the line has gone quiet after a failed chunk.
+ */
+static void resumeDownload(VC0706_Xfer_t *x)
+{
+    Camera_t *cam = x->cam;
+    uint32 left = x->frameLen - cam->frameptr;
+
+    rxReset(&cam->rx);
+    x->chunk = left < VC0706_CHUNK_SIZE ? left : VC0706_CHUNK_SIZE;
+    x->nextChunk = 0;
+    sendStep(x, VC0706_STEP_READ);
+}
+
+/**
+ * Handles a READ_FBUF chunk that didn't arrive intact. Chunks are stored in order, so everything before
+ * cam->frameptr is already safe; within the frame's retry budget only the rest is asked for again. Once the budget is
+ * spent the frame is abandoned, and retaken straight away if the retry policy says so.
+ */
+static void retryChunk(VC0706_Xfer_t *x, const char *why)
+{
+    Camera_t *cam = x->cam;
+
+    if (x->retries >= VC0706_Config.retryBudget)
+    {
+        VC0706_CaptureTlmPkt.vc0706_retries_exhausted++;
+        CFE_EVS_SendEvent(VC0706_REPLY_ERR_EID, CFE_EVS_ERROR, "Camera %d abandoned frame at %d of %u bytes after %d retries",
+                          cam->ttyInterface, cam->frameptr, x->frameLen, x->retries);
+        if (VC0706_Config.retryPolicy == VC0706_RETRY_RECAPTURE && x->recaptures < VC0706_MAX_RECAPTURES)
+        {
+            x->recaptures++;
+            VC0706_CaptureTlmPkt.vc0706_recaptures++;
+            VC0706_SchedRecapture();
+        }
+        failXfer(x, why);
+        return;
+    }
+
+    stepPerfExit(x);
+    x->retries++;
+    VC0706_CaptureTlmPkt.vc0706_chunk_retries++;
+    VC0706_CaptureTlmPkt.vc0706_bytes_resumed += (uint32)cam->frameptr;
+    OS_printf("VC0706: Camera %d chunk at offset %d failed: %s, retry %d of %d\n", cam->ttyInterface, cam->frameptr, why,
+              x->retries, VC0706_Config.retryBudget);
+
+    // The rest of this chunk, and the one already requested after it, may still be on the way
+    uint64_t now = monotonicMs();
+    rxReset(&cam->rx);
+    x->state = VC0706_XFER_DRAIN;
+    x->drainLimit = now + wireTimeMs(cam, 2 * (VC0706_CHUNK_SIZE + 2 * VC0706_REPLY_HEADER_LEN));
+    x->deadline = now + VC0706_RETRY_QUIET_MS;
+}
+
+/**
+ * Starts the download of a frozen frame once its length is known.
+ */
+static void beginDownload(VC0706_Xfer_t *x)
+{
+    Camera_t *cam = x->cam;
+
+    x->frameLen = ((uint32)x->data[0] << 24) | ((uint32)x->data[1] << 16) | ((uint32)x->data[2] << 8) | x->data[3];
+
+    // A length beyond anything the camera can hold means the reply was garbled
+    if (x->frameLen == 0 || x->frameLen > VC0706_MAX_FRAME_LEN)
+    {
+        CFE_EVS_SendEvent(VC0706_LEN_ERR_EID, CFE_EVS_ERROR, "Camera %d image length invalid. Length [%u] Expected 1 - %u",
+                          cam->ttyInterface, x->frameLen, VC0706_MAX_FRAME_LEN);
+        failXfer(x, "bad length");
+        return;
+    }
+
+    // Hand the file to the storage task up front so chunks can be written out as they arrive
+    if (VC0706_StorageBegin(cam->ttyInterface, x->path, x->frameLen, x->priority) == -1)
+    {
+        failXfer(x, "storage refused image");
+        x->result = (char *)NULL;
+        return;
+    }
+    x->storing = true;
+
+    x->startMs = monotonicMs();
+    x->retries = 0;
+    cam->frameptr = 0;
+    x->chunk = x->frameLen < VC0706_CHUNK_SIZE ? x->frameLen : VC0706_CHUNK_SIZE;
+    sendStep(x, VC0706_STEP_READ);
+}
+
+/** Upper bounds of the capture latency histogram buckets in ms; the last bucket takes everything above */
+static const uint32 VC0706_LatencyBoundsMs[VC0706_LATENCY_BUCKETS - 1] = {250, 500, 1000, 2000, 4000, 8000, 16000};
+/** Upper bounds of the image size histogram buckets in bytes; the last bucket takes everything above */
+static const uint32 VC0706_SizeBounds[VC0706_SIZE_BUCKETS - 1] = {2048, 4096, 8192, 16384, 32768, 65536, 131072};
+
+/**
+ * Finds the histogram bucket a value falls in.
+ * \param bounds - The buckets' inclusive upper bounds, ascending
+ * \param count - The number of bounds. There is one more bucket than bounds.
+ */
+static int histogramBucket(const uint32 *bounds, int count, uint32 value)
+{
+    int i;
+    for (i = 0; i < count && value > bounds[i]; i++)
+        ;
+    return i;
+}
+
+/**
+ * Wraps up a frame whose every chunk has been handed to storage.
+ */
+static void finishDownload(VC0706_Xfer_t *x)
+{
+    Camera_t *cam = x->cam;
+
+    // Storage closes the file and announces it while we move on
+    VC0706_StorageEnd(cam->ttyInterface, true);
+    x->storing = false;
+    x->recaptures = 0;
+    x->suspect = false;
+    VC0706_TimingRecord(VC0706_PHASE_FRAME, monotonicUs() - x->frameUs);
+
+    // Steer the next frame toward the size budget. A frame taken at a plan entry's ratio says nothing about the
+    // controller's own, so it's only recorded.
+    adjustCompression(cam, x->frameLen, x->compression == cam->compression ? VC0706_Config.sizeTargetBytes : 0);
+
+    uint64_t elapsedMs = monotonicMs() - x->startMs;
+    cam->bytesPerSec = elapsedMs > 0 ? (uint32)((uint64_t)x->frameLen * 1000 / elapsedMs) : 0;
+
+    VC0706_CaptureTlmPkt.vc0706_bytes_transferred += x->frameLen;
+    VC0706_CaptureTlmPkt.vc0706_download_ms += elapsedMs;
+    if (cam->bytesPerSec > VC0706_CaptureTlmPkt.vc0706_throughput_peak_bps)
+        VC0706_CaptureTlmPkt.vc0706_throughput_peak_bps = cam->bytesPerSec;
+    uint32 latencyMs = (uint32)((monotonicUs() - x->frameUs) / 1000);
+    VC0706_CaptureTlmPkt.vc0706_latency_hist[histogramBucket(VC0706_LatencyBoundsMs, VC0706_LATENCY_BUCKETS - 1, latencyMs)]++;
+    VC0706_CaptureTlmPkt.vc0706_size_hist[histogramBucket(VC0706_SizeBounds, VC0706_SIZE_BUCKETS - 1, x->frameLen)]++;
+    CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_INFORMATION, "Camera %d read %u bytes in %u ms (%u B/s)",
+                      cam->ttyInterface, x->frameLen, (unsigned int)elapsedMs, cam->bytesPerSec);
+
+    snprintf(cam->imageName, sizeof(cam->imageName), "%s", x->path);
+    x->result = cam->imageName;
+
+    sendStep(x, VC0706_STEP_RESUME);
+}
+
+/**
+ * Acts on a complete, validated reply header.
+ */
+static void onHeader(VC0706_Xfer_t *x)
+{
+    Camera_t *cam = x->cam;
+
+    if (x->step == VC0706_STEP_READ)
+    {
+        // Queue up the next chunk while this one is still on the wire
+        uint32 next = cam->frameptr + x->chunk;
+        x->nextChunk = 0;
+        if (next < x->frameLen)
+        {
+            x->nextChunk = (x->frameLen - next) < VC0706_CHUNK_SIZE ? (x->frameLen - next) : VC0706_CHUNK_SIZE;
+            requestChunk(cam, next, x->nextChunk);
+        }
+
+        x->slot = cam->ring[cam->ringHead];
+        cam->ringHead = (cam->ringHead + 1) % VC0706_RING_SLOTS;
+        x->chunkGot = 0;
+        x->state = VC0706_XFER_PAYLOAD;
+        x->deadline = monotonicMs() + wireTimeMs(cam, x->chunk + VC0706_REPLY_HEADER_LEN);
+    }
+    else if (x->dataWant > 0)
+    {
+        x->state = VC0706_XFER_HEADER;
+    }
+    else
+    {
+        // Nothing follows the header, so the step is complete
+        stepPerfExit(x);
+        switch (x->step)
+        {
+        case VC0706_STEP_DOWNSIZE:
+            x->cam->downsizeApplied = x->cam->downsize;
+            continueSetup(x);
+            break;
+        case VC0706_STEP_COMPRESS:
+            x->cam->compressionApplied = x->compression;
+            continueSetup(x);
+            break;
+        case VC0706_STEP_FREEZE:
+            VC0706_TimingRecord(VC0706_PHASE_FREEZE, monotonicUs() - x->phaseUs);
+            sendStep(x, VC0706_STEP_LENGTH);
+            break;
+        case VC0706_STEP_RESUME:
+        default:
+            x->state = VC0706_XFER_IDLE;
+            break;
+        }
+    }
+}
+
+/**
+ * Acts on the fixed-size data that followed a reply header.
+ */
+static void onData(VC0706_Xfer_t *x)
+{
+    stepPerfExit(x);
+    if (x->step == VC0706_STEP_VERSION)
+    {
+        x->suspect = false;
+        VC0706_TimingRecord(VC0706_PHASE_SETUP, monotonicUs() - x->frameUs);
+        x->state = VC0706_XFER_SYNC_WAIT;
+    }
+    else if (x->step == VC0706_STEP_LENGTH)
+    {
+        VC0706_TimingRecord(VC0706_PHASE_LENGTH, monotonicUs() - x->phaseUs);
+        beginDownload(x);
+    }
+}
+
+/**
+ * Acts on the reply frame that closes a READ_FBUF chunk.
+ */
+static void onTail(VC0706_Xfer_t *x)
+{
+    Camera_t *cam = x->cam;
+
+    stepPerfExit(x);
+    VC0706_TimingRecord(VC0706_PHASE_TAIL, monotonicUs() - x->phaseUs);
+
+    if (VC0706_StorageWrite(&cam->ttyInterface, x->slot, x->chunk) < 0)
+    {
+        failXfer(x, "storage write failed");
+        return;
+    }
+    cam->frameptr += x->chunk;
+
+    if ((uint32)cam->frameptr >= x->frameLen)
+    {
+        finishDownload(x);
+        return;
+    }
+
+    // The next chunk's request already went out, so just wait for its header
+    x->chunk = x->nextChunk;
+    x->state = VC0706_XFER_CMD_SENT;
+    x->deadline = monotonicMs() + wireTimeMs(cam, x->chunk + 2 * VC0706_REPLY_HEADER_LEN);
+    x->phaseUs = monotonicUs();
+    stepPerfEntry(x);
+}
+
+/**
+ * Feeds the bytes already in a camera's receive ring through its state machine.
+ * \returns true if the state machine moved on, false if it needs more bytes
+ */
+static bool parseBuffered(VC0706_Xfer_t *x)
+{
+    Camera_t *cam = x->cam;
+    uint32 got;
+
+    switch (x->state)
+    {
+    case VC0706_XFER_CMD_SENT:
+    case VC0706_XFER_TAIL:
+        switch (rxNextReply(&cam->rx, &x->expect, x->hdr))
+        {
+        case VC0706_PARSE_REPLY:
+            x->aliveMs = monotonicMs();
+            if (x->state == VC0706_XFER_TAIL)
+                onTail(x);
+            else
+                onHeader(x);
+            return true;
+        case VC0706_PARSE_ERROR:
+            CFE_EVS_SendEvent(VC0706_REPLY_ERR_EID, CFE_EVS_ERROR, "Camera %d refused command 0x%x, status [%x]",
+                              cam->ttyInterface, x->hdr[2], x->hdr[3]);
+            countReplyFailure(x->expect.cmd, false);
+            if (x->step == VC0706_STEP_READ)
+                retryChunk(x, x->state == VC0706_XFER_TAIL ? "bad chunk tail" : "bad chunk header");
+            else
+                failXfer(x, "bad reply header");
+            return true;
+        default:
+            return false;
+        }
+
+    case VC0706_XFER_HEADER:
+        got = rxTake(&cam->rx, x->data + x->dataLen, x->dataWant - x->dataLen);
+        if (got == 0)
+            return false;
+        x->dataLen += (uint8)got;
+        if (x->dataLen == x->dataWant)
+            onData(x);
+        return true;
+
+    default:
+        // Nothing expected; pick out motion alerts and let the rest go
+        rxNextReply(&cam->rx, NULL, x->hdr);
+        return false;
+    }
+}
+
+/**
+ * Reads whatever a camera has sent and feeds it through its state machine.
+ */
+static void onReadable(VC0706_Xfer_t *x)
+{
+    Camera_t *cam = x->cam;
+
+    for (;;)
+    {
+        // After a failed chunk, everything is thrown away until the line has been quiet for a while
+        if (x->state == VC0706_XFER_DRAIN)
+        {
+            rxReset(&cam->rx);
+            if (rxFill(&cam->rx, cam->fd) <= 0)
+                return;
+            uint64_t quiet = monotonicMs() + VC0706_RETRY_QUIET_MS;
+            x->deadline = quiet < x->drainLimit ? quiet : x->drainLimit;
+            continue;
+        }
+
+        // Image data skips the receive ring once it's drained, so chunks land straight in their slot
+        if (x->state == VC0706_XFER_PAYLOAD)
+        {
+            uint8_t *dest = x->slot + x->chunkGot;
+            uint32 want = x->chunk - x->chunkGot;
+            uint32 got = rxTake(&cam->rx, dest, want);
+            if (got == 0)
+            {
+                ssize_t n = read(cam->fd, dest, want);
+                if (n <= 0)
+                    return;
+                got = (uint32)n;
+            }
+
+            x->chunkGot += got;
+            if (x->chunkGot == x->chunk)
+            {
+                uint64_t nowUs = monotonicUs();
+                VC0706_TimingRecord(VC0706_PHASE_CHUNK, nowUs - x->phaseUs);
+                x->phaseUs = nowUs;
+                x->state = VC0706_XFER_TAIL;
+            }
+            continue;
+        }
+
+        // Replies are framed out of the ring, which is only topped up once it has nothing more to give
+        if (!parseBuffered(x) && rxFill(&cam->rx, cam->fd) <= 0)
+            return;
+    }
+}
+
+/**
+ * Starts a capture on a camera. The camera is probed if it is due one, then frozen together with every other started
+ * camera once they have all answered, then downloaded. Call VC0706_ReactorRun() to drive the captures.
+ * \param index - The camera to capture from
+ * \param path - Where to store the frame
+ * \param priority - Priority to store the frame with; see the VC0706_PRIORITY_ values
+ * \returns 0 if the capture was started, -1 otherwise
+ */
+int VC0706_ReactorStart(int index, const char *path, uint8 priority)
+{
+    if (index < 0 || index >= VC0706_MAX_CAMERAS || !cams[index].ready)
+        return -1;
+
+    // A new resolution only takes hold after a reset, which reopens the port, so it's applied before the camera is
+    // watched. If the camera won't take it, the frame is still taken at the size it has.
+    const VC0706_PlanEntry_t *plan = VC0706_PlanCurrent();
+    cams[index].imageSize = plan ? plan->ImageSize : VC0706_Config.imageSize;
+    if (cams[index].imageSize != cams[index].imageSizeApplied)
+    {
+        setImageSize(&cams[index], cams[index].imageSize);
+        if (!cams[index].ready)
+            return -1;
+    }
+    if (watchCamera(index) == -1)
+        return -1;
+
+    VC0706_Xfer_t *x = &VC0706_Xfers[index];
+    snprintf(x->path, sizeof(x->path), "%s", path);
+    x->priority = priority;
+    x->result = "";
+    x->storing = false;
+    x->started = true;
+    x->frameUs = monotonicUs();
+
+    // Clear out anything left over from the last capture
+    rxReset(&x->cam->rx);
+    pollDrain(x->cam->fd, 0, VC0706_DRAIN_MAX_MS);
+
+    // The LED warms up while the cameras are probed
+    if (VC0706_LedOnMs == 0)
+    {
+        led_on(&led);
+        VC0706_LedOnMs = monotonicMs();
+    }
+
+    // Bring the downsize level and compression in line with what's wanted first, if they have moved. A planned capture
+    // brings its own settings. Its compression is for this frame only; the size controller's ratio is left as it was
+    // and goes back on the camera with the next unplanned capture.
+    x->cam->downsize = plan ? plan->Downsize : VC0706_Config.downsize;
+    x->compression = plan && plan->Compression != 0 ? plan->Compression : x->cam->compression;
+    continueSetup(x);
+    return 0;
+}
+
+/**
+ * Freezes every camera that is waiting at the sync point, back-to-back, and records how far apart the commands went.
+ */
+static void freezeAll(void)
+{
+    CFE_ES_PerfLogEntry(VC0706_LED_PERF_ID);
+    uint64_t warm = monotonicMs() - VC0706_LedOnMs;
+    if (warm < VC0706_LED_WARMUP_MS)
+        OS_TaskDelay((uint32)(VC0706_LED_WARMUP_MS - warm));
+    CFE_ES_PerfLogExit(VC0706_LED_PERF_ID);
+
+    struct timespec first, last;
+    bool frozen = false;
+    int i;
+    for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+    {
+        if (VC0706_Xfers[i].state != VC0706_XFER_SYNC_WAIT)
+            continue;
+        sendStep(&VC0706_Xfers[i], VC0706_STEP_FREEZE);
+        clock_gettime(CLOCK_MONOTONIC, &last);
+        if (!frozen)
+            first = last;
+        frozen = true;
+    }
+
+    led_off(&led);
+    VC0706_LedOnMs = 0;
+
+    uint32 skewUs = (uint32)((last.tv_sec - first.tv_sec) * 1000000 + (last.tv_nsec - first.tv_nsec) / 1000);
+    VC0706_HkTelemetryPkt.vc0706_sync_skew_us = skewUs;
+    if (skewUs > VC0706_HkTelemetryPkt.vc0706_sync_skew_max_us)
+        VC0706_HkTelemetryPkt.vc0706_sync_skew_max_us = skewUs;
+}
+
+/**
+ * Drives every started capture until all of them have finished or failed.
+ * \returns The number of cameras whose frame was handed to storage
+ */
+int VC0706_ReactorRun(void)
+{
+    struct epoll_event events[VC0706_MAX_CAMERAS];
+    int i;
+
+    for (;;)
+    {
+        bool busy = false;
+        bool probing = false;
+        bool waiting = false;
+        uint64_t now = monotonicMs();
+        uint64_t nextDeadline = now + VC0706_REPLY_TIMEOUT_MS;
+
+        for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+        {
+            VC0706_Xfer_t *x = &VC0706_Xfers[i];
+            if (x->state == VC0706_XFER_IDLE)
+                continue;
+            if (x->state == VC0706_XFER_SYNC_WAIT)
+            {
+                waiting = true;
+                continue;
+            }
+
+            // A camera that has gone quiet only fails itself, and a chunk that has gone missing is retried
+            if (now >= x->deadline)
+            {
+                if (x->state == VC0706_XFER_DRAIN)
+                {
+                    resumeDownload(x);
+                }
+                else
+                {
+                    countReplyFailure(x->expect.cmd, true);
+                    if (x->step == VC0706_STEP_READ)
+                        retryChunk(x, "timeout");
+                    else
+                        failXfer(x, "timeout");
+                }
+                if (x->state == VC0706_XFER_IDLE)
+                    continue;
+            }
+            busy = true;
+            if (x->step <= VC0706_STEP_VERSION)
+                probing = true;
+            if (x->deadline < nextDeadline)
+                nextDeadline = x->deadline;
+        }
+
+        // Once every camera has answered its probe, freeze them all together
+        if (waiting && !probing)
+        {
+            freezeAll();
+            continue;
+        }
+        if (!busy)
+            break;
+
+        int n = epoll_wait(VC0706_Epoll, events, VC0706_MAX_CAMERAS, (int)(nextDeadline - now));
+        for (i = 0; i < n; i++)
+        {
+            if (events[i].data.u32 < VC0706_MAX_CAMERAS)
+                onReadable(&VC0706_Xfers[events[i].data.u32]);
+        }
+    }
+
+    if (VC0706_LedOnMs != 0)
+    {
+        led_off(&led);
+        VC0706_LedOnMs = 0;
+    }
+
+    int stored = 0;
+    for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+    {
+        VC0706_Xfer_t *x = &VC0706_Xfers[i];
+        if (!x->started)
+        {
+            x->result = "";
+        }
+        else if (x->result != (char *)NULL && x->result[0] != '\0')
+        {
+            stored++;
+            VC0706_CaptureTlmPkt.vc0706_frames_captured++;
+        }
+        else
+        {
+            VC0706_CaptureTlmPkt.vc0706_frames_failed++;
+        }
+        x->started = false;
+    }
+    return stored;
+}
+
+/**
+ * Idles on every enabled camera's serial line until one of them reports motion, or the timeout passes.
+ * \param timeoutMs - The longest time to wait
+ * \param[out] alerts - Set to the number of motion alerts received from each camera
+ * \returns The total number of motion alerts received
+ */
+int VC0706_ReactorWaitMotion(uint32 timeoutMs, uint32 alerts[VC0706_MAX_CAMERAS])
+{
+    struct epoll_event events[VC0706_MAX_CAMERAS];
+    int total = 0;
+    int i;
+
+    for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+    {
+        alerts[i] = 0;
+        if (i < VC0706_Config.cameraCount && cams[i].ready)
+            watchCamera(i);
+    }
+
+    int n = epoll_wait(VC0706_Epoll, events, VC0706_MAX_CAMERAS, (int)timeoutMs);
+    for (i = 0; i < n; i++)
+    {
+        uint32 index = events[i].data.u32;
+        if (index >= VC0706_MAX_CAMERAS)
+            continue;
+
+        // The parser counts motion frames wherever they turn up in the stream
+        Camera_t *cam = VC0706_Xfers[index].cam;
+        while (rxFill(&cam->rx, cam->fd) > 0)
+            rxNextReply(&cam->rx, NULL, VC0706_Xfers[index].hdr);
+        alerts[index] = cam->rx.motionAlerts;
+        cam->rx.motionAlerts = 0;
+        total += (int)alerts[index];
+    }
+    return total;
+}
+
+/**
+ * Gets the outcome of a camera's last capture.
+ * \param index - The camera to look up
+ * \returns The image name if the frame was handed to storage, "" if the camera failed, or NULL if storage refused it
+ */
+char *VC0706_ReactorResult(int index)
+{
+    if (index < 0 || index >= VC0706_MAX_CAMERAS)
+        return "";
+    return VC0706_Xfers[index].result;
+}
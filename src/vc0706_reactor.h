@@ -0,0 +1,83 @@
+/**
+ * \file vc0706_reactor.h
+ * \brief Header for the event-driven engine that runs captures on every camera from one task
+ */
+#ifndef _vc0706_reactor_h_
+#define _vc0706_reactor_h_
+
+#include "vc0706.h"
+
+/** Time in milliseconds the LED is given to warm up before the cameras are frozen */
+#define VC0706_LED_WARMUP_MS 50
+
+/**
+ * Where a camera is in the exchange of its current command
+ */
+typedef enum
+{
+    VC0706_XFER_IDLE,      /**< Not taking part in a capture, or finished with it */
+    VC0706_XFER_CMD_SENT,  /**< Command written, collecting the reply header */
+    VC0706_XFER_HEADER,    /**< Reply header received, collecting the fixed-size data that follows it */
+    VC0706_XFER_PAYLOAD,   /**< Streaming a READ_FBUF chunk's image bytes */
+    VC0706_XFER_TAIL,      /**< Checking the reply frame that closes a READ_FBUF chunk */
+    VC0706_XFER_SYNC_WAIT, /**< Probed and waiting for every other camera so they can all be frozen together */
+    VC0706_XFER_DRAIN      /**< A chunk failed; waiting for the line to go quiet before re-requesting the rest */
+} VC0706_XferState_t;
+
+/**
+ * Which command of the capture sequence a camera is on
+ */
+typedef enum
+{
+    VC0706_STEP_DOWNSIZE, /**< DOWNSIZE_CTRL, only when it needs changing */
+    VC0706_STEP_COMPRESS, /**< WRITE_DATA to the compression ratio register, only when it needs changing */
+    VC0706_STEP_VERSION, /**< GEN_VERSION liveness probe */
+    VC0706_STEP_FREEZE,  /**< FBUF_CTRL stop current frame */
+    VC0706_STEP_LENGTH,  /**< GET_FBUF_LEN */
+    VC0706_STEP_READ,    /**< READ_FBUF, once per chunk */
+    VC0706_STEP_RESUME   /**< FBUF_CTRL resume */
+} VC0706_XferStep_t;
+
+/**
+ * The state of one camera's capture, as driven by the reactor
+ */
+typedef struct
+{
+    Camera_t *cam;              /**< The camera being driven */
+    uint8 state;                /**< One of VC0706_XferState_t */
+    uint8 step;                 /**< One of VC0706_XferStep_t */
+    VC0706_Reply_t expect;      /**< The reply the last command should get back */
+    uint8 hdr[VC0706_REPLY_HEADER_LEN]; /**< The last reply header (or READ_FBUF tail) framed */
+    uint8 data[VC0706_VERSION_LEN]; /**< Fixed-size reply data being collected */
+    uint8 dataLen;              /**< Bytes of data received so far */
+    uint8 dataWant;             /**< Bytes of data the current reply carries */
+    uint32 frameLen;            /**< Length of the frozen frame */
+    uint32 chunk;               /**< Length of the READ_FBUF chunk being received */
+    uint32 chunkGot;            /**< Bytes of the current chunk received so far */
+    uint32 nextChunk;           /**< Length of the chunk already requested after this one, or 0 */
+    uint8_t *slot;              /**< The ring slot the current chunk is landing in */
+    bool storing;               /**< Whether storage has an image file open for this camera */
+    uint64_t deadline;          /**< Monotonic time in ms by which the current reply must be complete */
+    uint64_t drainLimit;        /**< In VC0706_XFER_DRAIN, when to stop waiting for quiet and re-request anyway */
+    uint8 retries;              /**< Chunks of the current frame re-requested so far */
+    uint8 recaptures;           /**< Recaptures asked for in a row since the camera last stored a frame */
+    uint64_t aliveMs;           /**< When the camera last sent a reply that checked out (monotonic ms) */
+    bool suspect;               /**< Whether a capture has failed since the camera last proved alive */
+    uint64_t startMs;           /**< When the frame download began, for throughput */
+    uint64_t frameUs;           /**< When the capture was started, for phase timing (monotonic us) */
+    uint64_t phaseUs;           /**< When the phase being timed began (monotonic us) */
+    char path[OS_MAX_PATH_LEN]; /**< Where the frame is to be stored */
+    uint8 priority;             /**< Priority the frame is to be stored with */
+    uint8 compression;          /**< Compression ratio this frame is taken at: the size controller's, or a plan entry's */
+    char *result;               /**< Outcome: the image name, "" if the camera failed, NULL if storage refused it */
+    bool started;               /**< Whether the camera was started in the current round of captures */
+    bool perfOpen;              /**< Whether the current step's performance log entry is awaiting its exit */
+} VC0706_Xfer_t;
+
+int VC0706_ReactorInit(void);
+int VC0706_ReactorStart(int index, const char *path, uint8 priority);
+int VC0706_ReactorRun(void);
+int VC0706_ReactorWaitMotion(uint32 timeoutMs, uint32 alerts[VC0706_MAX_CAMERAS]);
+char *VC0706_ReactorResult(int index);
+
+#endif
@@ -0,0 +1,199 @@
+/**
+ * \file vc0706_sched.c
+ * \brief Decides when the capture task takes its next picture
+ *
+ * Captures are triggered by the capture mode: back-to-back, on motion, on a fixed period, or once per scheduler
+ * wakeup message. Ground can also ask for a burst of captures in any mode, and the capture plan table can schedule
+ * captures for particular times; planned captures come first. Triggers raised by the main task reach the
+ * capture task through an OSAL queue. The delay between when a capture was due and when it started is reported as
+ * jitter, and captures that could not be started in time are counted as missed deadlines.
+ */
+#include "vc0706_sched.h"
+#include "vc0706_child.h"
+#include "vc0706_device.h"
+#include "vc0706_plan.h"
+#include "vc0706_serial.h"
+
+/** Queue of triggers from the main task */
+static uint32 VC0706_TriggerQueue;
+/** Captures still owed to the current burst */
+static uint16 VC0706_BurstRemaining = 0;
+/** Whether a failed frame is to be retaken before anything else but the plan */
+static bool VC0706_RecapturePending = false;
+/** When the next periodic capture is due (monotonic ms), or 0 if the period schedule needs restarting */
+static uint64_t VC0706_NextDue = 0;
+/** Priority of the capture VC0706_SchedWait() last let go ahead; a recapture keeps the priority of the one it retakes */
+static uint8 VC0706_CapturePriority = VC0706_PRIORITY_ROUTINE;
+
+/**
+ * Creates the trigger queue. Must run before the main task starts forwarding wakeups.
+ * \returns OS_SUCCESS, or the OSAL error code
+ */
+int VC0706_SchedInit(void)
+{
+    int32 result = OS_QueueCreate(&VC0706_TriggerQueue, "VC0706_TRIG_Q", VC0706_TRIGGER_QUEUE_DEPTH, sizeof(VC0706_Trigger_t), 0);
+    if (result != OS_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR,
+                          "Scheduler initialization error: queue create failed: result = %d", (int)result);
+    }
+    return result;
+}
+
+/**
+ * Raises a trigger for the capture task. Called from the main task.
+ * \param type - One of VC0706_TriggerType_t
+ * \param count - Number of captures, for VC0706_TRIGGER_BURST
+ */
+void VC0706_SchedTrigger(uint8 type, uint16 count)
+{
+    VC0706_Trigger_t trigger;
+    trigger.type = type;
+    trigger.count = count;
+    trigger.time = monotonicMs();
+
+    // A full queue means the capture task is already that far behind
+    if (OS_QueuePut(VC0706_TriggerQueue, &trigger, sizeof(trigger), 0) != OS_SUCCESS)
+        VC0706_HkTelemetryPkt.vc0706_missed_deadlines++;
+}
+
+/**
+ * Has the next capture taken straight away, to replace a frame that was abandoned. Called from the capture task.
+ */
+void VC0706_SchedRecapture(void)
+{
+    VC0706_RecapturePending = true;
+}
+
+/**
+ * Records how late a capture started relative to when it was due.
+ */
+static void recordJitter(uint64_t due, uint64_t now)
+{
+    uint32 jitter = now > due ? (uint32)(now - due) : 0;
+    VC0706_HkTelemetryPkt.vc0706_trigger_jitter_ms = jitter;
+    if (jitter > VC0706_HkTelemetryPkt.vc0706_trigger_jitter_max_ms)
+        VC0706_HkTelemetryPkt.vc0706_trigger_jitter_max_ms = jitter;
+    VC0706_HkTelemetryPkt.vc0706_triggers++;
+}
+
+/**
+ * Waits for the next capture to become due.
+ * \returns true if a capture should be taken now, false if the wait ran out (so settings can be re-checked)
+ */
+bool VC0706_SchedWait(void)
+{
+    VC0706_Trigger_t trigger;
+    uint32 size;
+    uint8 mode = VC0706_Config.captureMode;
+    uint64_t now = monotonicMs();
+    uint32 planWaitMs;
+    int32 timeout;
+
+    if (VC0706_PlanNext(&planWaitMs))
+    {
+        VC0706_CapturePriority = VC0706_PRIORITY_REQUESTED;
+        return true;
+    }
+
+    if (VC0706_RecapturePending)
+    {
+        VC0706_RecapturePending = false;
+        return true;
+    }
+
+    if (VC0706_BurstRemaining > 0)
+    {
+        VC0706_BurstRemaining--;
+        VC0706_CapturePriority = VC0706_PRIORITY_REQUESTED;
+        return true;
+    }
+
+    if (mode != VC0706_MODE_PERIODIC)
+        VC0706_NextDue = 0;
+    else if (VC0706_NextDue == 0)
+        VC0706_NextDue = now;
+
+    // Only block here when nothing else will; motion mode does its waiting on the serial lines
+    switch (mode)
+    {
+    case VC0706_MODE_PERIODIC:
+        timeout = VC0706_NextDue > now ? (int32)(VC0706_NextDue - now) : OS_CHECK;
+        if (timeout > (int32)planWaitMs)
+            timeout = (int32)planWaitMs;
+        break;
+    case VC0706_MODE_WAKEUP:
+        timeout = (int32)planWaitMs;
+        break;
+    default:
+        timeout = OS_CHECK;
+        break;
+    }
+
+    if (OS_QueueGet(VC0706_TriggerQueue, &trigger, sizeof(trigger), &size, timeout) == OS_SUCCESS)
+    {
+        now = monotonicMs();
+        if (trigger.type == VC0706_TRIGGER_BURST)
+        {
+            VC0706_BurstRemaining = trigger.count > 0 ? trigger.count - 1 : 0;
+            VC0706_CapturePriority = VC0706_PRIORITY_REQUESTED;
+            recordJitter(trigger.time, now);
+            return trigger.count > 0;
+        }
+
+        if (mode == VC0706_MODE_WAKEUP)
+        {
+            // Wakeups that piled up while we were busy can't be honoured any more
+            while (OS_QueueGet(VC0706_TriggerQueue, &trigger, sizeof(trigger), &size, OS_CHECK) == OS_SUCCESS)
+            {
+                if (trigger.type == VC0706_TRIGGER_BURST)
+                    VC0706_BurstRemaining += trigger.count;
+                else
+                    VC0706_HkTelemetryPkt.vc0706_missed_deadlines++;
+            }
+            VC0706_CapturePriority = VC0706_PRIORITY_ROUTINE;
+            recordJitter(trigger.time, now);
+            return true;
+        }
+        // Wakeups are ignored outside wakeup mode
+    }
+
+    now = monotonicMs();
+    switch (mode)
+    {
+    case VC0706_MODE_CONTINUOUS:
+        VC0706_CapturePriority = VC0706_PRIORITY_ROUTINE;
+        return true;
+
+    case VC0706_MODE_MOTION:
+        VC0706_CapturePriority = VC0706_PRIORITY_MOTION;
+        return VC0706_waitForMotion(planWaitMs);
+
+    case VC0706_MODE_PERIODIC:
+    {
+        if (now < VC0706_NextDue)
+            return false;
+
+        // Every whole period we overran is a capture that never happened
+        uint32 period = VC0706_Config.periodMs > 0 ? VC0706_Config.periodMs : 1;
+        uint64_t lateness = now - VC0706_NextDue;
+        VC0706_HkTelemetryPkt.vc0706_missed_deadlines += (uint32)(lateness / period);
+        recordJitter(VC0706_NextDue, now);
+        VC0706_NextDue += (lateness / period + 1) * period;
+        VC0706_CapturePriority = VC0706_PRIORITY_ROUTINE;
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * Gets the priority the images from the capture VC0706_SchedWait() last let go ahead should be stored with.
+ * \returns One of the VC0706_PRIORITY_ values
+ */
+uint8 VC0706_SchedPriority(void)
+{
+    return VC0706_CapturePriority;
+}
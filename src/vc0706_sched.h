@@ -0,0 +1,42 @@
+/**
+ * \file vc0706_sched.h
+ * \brief Header for the VC0706 capture scheduler
+ */
+#ifndef _vc0706_sched_h_
+#define _vc0706_sched_h_
+
+#include "vc0706.h"
+
+/** Depth of the trigger queue between the main task and the capture task */
+#define VC0706_TRIGGER_QUEUE_DEPTH 8
+/** Longest time in milliseconds the capture task waits for a trigger before re-checking the capture settings */
+#define VC0706_SCHED_POLL_MS 250
+/** Largest burst that can be requested in one command */
+#define VC0706_MAX_BURST 64
+
+/**
+ * The kinds of trigger the main task can send the capture task
+ */
+typedef enum
+{
+    VC0706_TRIGGER_WAKEUP, /**< A scheduler wakeup message arrived */
+    VC0706_TRIGGER_BURST   /**< Ground asked for a burst of captures */
+} VC0706_TriggerType_t;
+
+/**
+ * A trigger passed from the main task to the capture task
+ */
+typedef struct
+{
+    uint8 type;    /**< One of VC0706_TriggerType_t */
+    uint16 count;  /**< Number of captures, for VC0706_TRIGGER_BURST */
+    uint64_t time; /**< Monotonic time in ms the trigger was raised, for jitter */
+} VC0706_Trigger_t;
+
+int VC0706_SchedInit(void);
+void VC0706_SchedTrigger(uint8 type, uint16 count);
+void VC0706_SchedRecapture(void);
+bool VC0706_SchedWait(void);
+uint8 VC0706_SchedPriority(void);
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * \file vc0706_segment.c
+ * \brief Writes frames into segment files and reads them back
+ *
+ * Storing every frame as its own file costs a create, a close and a directory entry per frame, and the file names run
+ * out at 9999 frames. In segment format the storage task instead appends each camera's frames to that camera's open
+ * segment and adds a fixed-size record to the segment's index. A frame that fails, or is dropped as a repeat, is
+ * cut off the data file, since its record never made it into the index. Readers find any frame by its
+ * position in the index or by its sequence number, and read as much or as little of it as they like.
+ */
+#include "vc0706_segment.h"
+#include "vc0706_jpeg.h"
+
+#include <unistd.h>
+
+/**
+ * Works out the path of a segment's index file: the data file's name with the index extension.
+ * \param path - The data file's full path
+ * \param indexPath - Where to put the index file's full path
+ * \param size - The size of indexPath
+ * \returns 0 on success, -1 if the data file has no extension or the index's path doesn't fit
+ */
+int VC0706_SegmentIndexPath(const char *path, char *indexPath, size_t size)
+{
+    snprintf(indexPath, size, "%s", path);
+    char *dot = strrchr(indexPath, '.');
+    if (dot == NULL || (size_t)(dot - indexPath) + sizeof(VC0706_SEGMENT_INDEX_EXT) > size)
+        return -1;
+    snprintf(dot, size - (size_t)(dot - indexPath), "%s", VC0706_SEGMENT_INDEX_EXT);
+    return 0;
+}
+
+/**
+ * Starts a new, empty segment.
+ * \param w - The writer, which must not have a segment open
+ * \param path - The data file's full path
+ * \returns OS_FS_SUCCESS, or OS_FS_ERROR if either file couldn't be created
+ */
+int32 VC0706_SegmentCreate(VC0706_SegmentWriter_t *w, const char *path)
+{
+    char indexPath[OS_MAX_PATH_LEN];
+
+    memset(w, 0, sizeof(*w));
+    w->dataFd = -1;
+    if (VC0706_SegmentIndexPath(path, indexPath, sizeof(indexPath)) != 0)
+        return OS_FS_ERROR;
+
+    int32 dataFd = OS_creat(path, (int32)OS_READ_WRITE);
+    if (dataFd < OS_FS_SUCCESS)
+        return OS_FS_ERROR;
+    int32 indexFd = OS_creat(indexPath, (int32)OS_READ_WRITE);
+    if (indexFd < OS_FS_SUCCESS)
+    {
+        OS_close(dataFd);
+        OS_remove(path);
+        return OS_FS_ERROR;
+    }
+
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    w->dataFd = dataFd;
+    w->indexFd = indexFd;
+    w->crc = 0xFFFFFFFFu;
+    w->endCrc = 0xFFFFFFFFu;
+    return OS_FS_SUCCESS;
+}
+
+/**
+ * Writes the next piece of the frame being stored.
+ * \returns OS_FS_SUCCESS, or OS_FS_ERROR if the write failed
+ */
+int32 VC0706_SegmentAppend(VC0706_SegmentWriter_t *w, const uint8 *data, uint32 len)
+{
+    int32 written = OS_write(w->dataFd, (void *)data, len);
+    if (written != (int32)len)
+        return OS_FS_ERROR;
+
+    w->crc = VC0706_Crc32(w->crc, data, len);
+    w->pos += len;
+    return OS_FS_SUCCESS;
+}
+
+/**
+ * Adds the frame written since the last commit or rewind to the index.
+ * \param w - The writer
+ * \param rec - The frame's record. Offset and Length are filled in here; the caller fills in the rest.
+ * \returns OS_FS_SUCCESS, or OS_FS_ERROR if the record couldn't be written (the frame is then rewound)
+ */
+int32 VC0706_SegmentCommit(VC0706_SegmentWriter_t *w, VC0706_SegmentRecord_t *rec)
+{
+    rec->Offset = w->end;
+    rec->Length = w->pos - w->end;
+    memset(rec->Spare, 0, sizeof(rec->Spare));
+
+    if (OS_write(w->indexFd, rec, sizeof(*rec)) != (int32)sizeof(*rec))
+    {
+        // A torn record would throw off every record after it
+        OS_lseek(w->indexFd, (int32)(w->frames * sizeof(*rec)), OS_SEEK_SET);
+        VC0706_SegmentRewind(w);
+        return OS_FS_ERROR;
+    }
+    w->end = w->pos;
+    w->endCrc = w->crc;
+    w->frames++;
+    return OS_FS_SUCCESS;
+}
+
+/**
+ * Cuts the data file back to the end of the last indexed frame. OSAL has no truncate, so the segment's virtual path is
+ * translated to the host's.
+ * \returns OS_FS_SUCCESS, or OS_FS_ERROR if the file couldn't be cut
+ */
+static int32 cutToEnd(VC0706_SegmentWriter_t *w)
+{
+    char localPath[OS_MAX_LOCAL_PATH_LEN];
+
+    if (OS_TranslatePath(w->path, localPath) != OS_FS_SUCCESS)
+        return OS_FS_ERROR;
+    if (truncate(localPath, (off_t)w->end) != 0)
+        return OS_FS_ERROR;
+    return OS_FS_SUCCESS;
+}
+
+/**
+ * Abandons the frame written since the last commit, cutting it off the data file so the file ends with the last
+ * indexed frame.
+ * \returns OS_FS_SUCCESS, or OS_FS_ERROR if the frame couldn't be cut off. The next frame still goes where it began,
+ *          but the file may keep some of it past the next frame's end, so the segment should be sealed.
+ */
+int32 VC0706_SegmentRewind(VC0706_SegmentWriter_t *w)
+{
+    OS_lseek(w->dataFd, (int32)w->end, OS_SEEK_SET);
+    w->pos = w->end;
+    w->crc = w->endCrc;
+    return cutToEnd(w);
+}
+
+/**
+ * Closes a segment; nothing more is added to it. Anything written after the last indexed frame is cut off first. If
+ * it can't be, it's kept, and end and the CRC are carried on over it so the CRC still covers the whole file. The index
+ * never points into it.
+ * \returns The CRC32 of the whole data file
+ */
+uint32 VC0706_SegmentSeal(VC0706_SegmentWriter_t *w)
+{
+    uint8 buf[256];
+    int32 got;
+
+    if (cutToEnd(w) != OS_FS_SUCCESS && OS_lseek(w->dataFd, (int32)w->end, OS_SEEK_SET) >= 0)
+    {
+        while ((got = OS_read(w->dataFd, buf, sizeof(buf))) > 0)
+        {
+            w->endCrc = VC0706_Crc32(w->endCrc, buf, (uint32)got);
+            w->end += (uint32)got;
+        }
+    }
+
+    OS_close(w->dataFd);
+    OS_close(w->indexFd);
+    w->dataFd = -1;
+    w->indexFd = -1;
+    return ~w->endCrc;
+}
+
+/**
+ * Opens a segment for reading. The segment may still be being written; frames added later show up in the count.
+ * \param r - The reader
+ * \param path - The data file's full path
+ * \returns OS_FS_SUCCESS, or OS_FS_ERROR if either file couldn't be opened
+ */
+int32 VC0706_SegmentOpen(VC0706_SegmentReader_t *r, const char *path)
+{
+    char indexPath[OS_MAX_PATH_LEN];
+
+    r->dataFd = -1;
+    r->indexFd = -1;
+    if (VC0706_SegmentIndexPath(path, indexPath, sizeof(indexPath)) != 0)
+        return OS_FS_ERROR;
+
+    r->dataFd = OS_open(path, OS_READ_ONLY, 0);
+    if (r->dataFd < OS_FS_SUCCESS)
+        return OS_FS_ERROR;
+    r->indexFd = OS_open(indexPath, OS_READ_ONLY, 0);
+    if (r->indexFd < OS_FS_SUCCESS)
+    {
+        OS_close(r->dataFd);
+        r->dataFd = -1;
+        return OS_FS_ERROR;
+    }
+    return OS_FS_SUCCESS;
+}
+
+/**
+ * Counts the frames in a segment.
+ * \returns The number of complete records in the index
+ */
+uint32 VC0706_SegmentCount(VC0706_SegmentReader_t *r)
+{
+    int32 size = OS_lseek(r->indexFd, 0, OS_SEEK_END);
+    return size > 0 ? (uint32)size / sizeof(VC0706_SegmentRecord_t) : 0;
+}
+
+/**
+ * Reads a frame's record by its position in the index.
+ * \param r - The reader
+ * \param n - The frame's position, from 0
+ * \param rec - Where to put the record
+ * \returns OS_FS_SUCCESS, or OS_FS_ERROR if there is no such frame
+ */
+int32 VC0706_SegmentRecord(VC0706_SegmentReader_t *r, uint32 n, VC0706_SegmentRecord_t *rec)
+{
+    if (OS_lseek(r->indexFd, (int32)(n * sizeof(*rec)), OS_SEEK_SET) < 0)
+        return OS_FS_ERROR;
+    if (OS_read(r->indexFd, rec, sizeof(*rec)) != (int32)sizeof(*rec))
+        return OS_FS_ERROR;
+    return OS_FS_SUCCESS;
+}
+
+/**
+ * Finds a frame's record by its sequence number. Sequence numbers only increase through a segment, so this is a
+ * binary search of the index.
+ * \param r - The reader
+ * \param sequence - The frame's sequence number
+ * \param rec - Where to put the record
+ * \returns OS_FS_SUCCESS, or OS_FS_ERROR if the segment doesn't hold the frame
+ */
+int32 VC0706_SegmentFind(VC0706_SegmentReader_t *r, uint32 sequence, VC0706_SegmentRecord_t *rec)
+{
+    uint32 lo = 0;
+    uint32 hi = VC0706_SegmentCount(r);
+
+    while (lo < hi)
+    {
+        uint32 mid = lo + (hi - lo) / 2;
+        if (VC0706_SegmentRecord(r, mid, rec) != OS_FS_SUCCESS)
+            return OS_FS_ERROR;
+        if (rec->Sequence == sequence)
+            return OS_FS_SUCCESS;
+        if (rec->Sequence < sequence)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return OS_FS_ERROR;
+}
+
+/**
+ * Reads part of a frame.
+ * \param r - The reader
+ * \param rec - The frame's record
+ * \param pos - Where in the frame to start
+ * \param buf - Where to put the bytes
+ * \param len - Most bytes to read
+ * \returns The number of bytes read, 0 past the end of the frame, or OS_FS_ERROR
+ */
+int32 VC0706_SegmentRead(VC0706_SegmentReader_t *r, const VC0706_SegmentRecord_t *rec, uint32 pos, void *buf, uint32 len)
+{
+    if (pos >= rec->Length)
+        return 0;
+    if (len > rec->Length - pos)
+        len = rec->Length - pos;
+    if (OS_lseek(r->dataFd, (int32)(rec->Offset + pos), OS_SEEK_SET) < 0)
+        return OS_FS_ERROR;
+    return OS_read(r->dataFd, buf, len);
+}
+
+/**
+ * Closes a segment opened for reading.
+ */
+void VC0706_SegmentClose(VC0706_SegmentReader_t *r)
+{
+    if (r->dataFd >= 0)
+        OS_close(r->dataFd);
+    if (r->indexFd >= 0)
+        OS_close(r->indexFd);
+    r->dataFd = -1;
+    r->indexFd = -1;
+}
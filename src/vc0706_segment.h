@@ -0,0 +1,81 @@
+/**
+ * \file vc0706_segment.h
+ * \brief Header for segment files, which hold many frames appended one after another, and their readers
+ *
+ * A segment is a pair of files sitting side by side in VC0706_IMAGE_DIR: a data file (VC0706_SEGMENT_EXT) holding the
+ * frames back to back, and an index file (VC0706_SEGMENT_INDEX_EXT) holding one VC0706_SegmentRecord_t per frame. A
+ * frame's record is only written once all of its data is, so a reader never sees part of a frame, even in a segment
+ * that is still being written. The reader functions use nothing but OSAL, so other apps (TIM) can link them.
+ */
+#ifndef _vc0706_segment_h_
+#define _vc0706_segment_h_
+
+#include "vc0706.h"
+
+/** Extension of segment data files */
+#define VC0706_SEGMENT_EXT ".seg"
+/** Extension of segment index files, which take their data file's name */
+#define VC0706_SEGMENT_INDEX_EXT ".idx"
+/** Size a segment's data file may reach before a new segment is started */
+#define VC0706_SEGMENT_MAX_BYTES (2 * 1024 * 1024)
+/** Most frames one segment may hold */
+#define VC0706_SEGMENT_MAX_FRAMES 1024
+/** How long storage may sit idle before the open segments are sealed and sent, in milliseconds */
+#define VC0706_SEGMENT_IDLE_MS 60000
+
+/**
+ * One frame's entry in a segment index. The index is an array of these, in the order the frames were stored.
+ */
+typedef struct
+{
+    uint32 Sequence;   /**< The frame's number in its camera's stream. Increases through a segment and across segments. */
+    uint32 Seconds;    /**< Spacecraft time (CFE_TIME) the frame was stored, seconds */
+    uint32 Subseconds; /**< Spacecraft time (CFE_TIME) the frame was stored, subseconds */
+    uint32 Offset;     /**< Where the frame starts in the data file */
+    uint32 Length;     /**< The frame's length in bytes */
+    uint32 Crc;        /**< CRC32 (IEEE 802.3) of the frame */
+    uint8 Camera;      /**< The camera the frame came from */
+    uint8 Spare[3];    /**< Padding, zero */
+} OS_PACK VC0706_SegmentRecord_t;
+
+/**
+ * A segment being written. Only the storage task writes segments.
+ */
+typedef struct
+{
+    char path[OS_MAX_PATH_LEN]; /**< The data file's full path */
+    int32 dataFd;               /**< The data file, or -1 if no segment is open */
+    int32 indexFd;              /**< The index file */
+    uint32 pos;                 /**< Where the next byte of data goes */
+    uint32 end;                 /**< End of the last frame in the index. Data past it belongs to no frame yet. Once
+                                     sealed, the data file's length. */
+    uint32 frames;              /**< Frames in the index */
+    uint32 crc;                 /**< CRC32 of the data file up to pos, before the final inversion */
+    uint32 endCrc;              /**< CRC32 of the data file up to end, before the final inversion */
+} VC0706_SegmentWriter_t;
+
+/**
+ * An open segment being read
+ */
+typedef struct
+{
+    int32 dataFd;  /**< The data file */
+    int32 indexFd; /**< The index file */
+} VC0706_SegmentReader_t;
+
+int VC0706_SegmentIndexPath(const char *path, char *indexPath, size_t size);
+
+int32 VC0706_SegmentCreate(VC0706_SegmentWriter_t *w, const char *path);
+int32 VC0706_SegmentAppend(VC0706_SegmentWriter_t *w, const uint8 *data, uint32 len);
+int32 VC0706_SegmentCommit(VC0706_SegmentWriter_t *w, VC0706_SegmentRecord_t *rec);
+int32 VC0706_SegmentRewind(VC0706_SegmentWriter_t *w);
+uint32 VC0706_SegmentSeal(VC0706_SegmentWriter_t *w);
+
+int32 VC0706_SegmentOpen(VC0706_SegmentReader_t *r, const char *path);
+uint32 VC0706_SegmentCount(VC0706_SegmentReader_t *r);
+int32 VC0706_SegmentRecord(VC0706_SegmentReader_t *r, uint32 n, VC0706_SegmentRecord_t *rec);
+int32 VC0706_SegmentFind(VC0706_SegmentReader_t *r, uint32 sequence, VC0706_SegmentRecord_t *rec);
+int32 VC0706_SegmentRead(VC0706_SegmentReader_t *r, const VC0706_SegmentRecord_t *rec, uint32 pos, void *buf, uint32 len);
+void VC0706_SegmentClose(VC0706_SegmentReader_t *r);
+
+#endif
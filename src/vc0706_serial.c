@@ -0,0 +1,157 @@
+/**
+ * \file vc0706_serial.c
+ * \brief Deadline-based serial I/O on the camera's file descriptor
+ *
+ * Every operation blocks in poll() until bytes arrive or its deadline passes, so callers wake as soon as the camera
+ * sends something and never spin on serialDataAvail().
+ */
+#include <poll.h>
+#include "vc0706_serial.h"
+
+/**
+ * Gets the current monotonic time in milliseconds.
+ */
+uint64_t monotonicMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Gives the monotonic clock in microseconds, for timing phases shorter than a millisecond.
+ */
+uint64_t monotonicUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Waits for the file descriptor to become readable or writable.
+ * \param fd - The file descriptor to wait on
+ * \param events - POLLIN or POLLOUT
+ * \param timeoutMs - The longest time to wait
+ * \returns 1 if the descriptor is ready, 0 on timeout, -1 on error
+ */
+static int waitReady(int fd, short events, int timeoutMs)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    int ret;
+    do
+    {
+        ret = poll(&pfd, 1, timeoutMs);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret > 0 && !(pfd.revents & events))
+        return -1;
+    return ret;
+}
+
+/**
+ * Waits for bytes to arrive on fd.
+ * \param fd - The file descriptor to wait on
+ * \param timeoutMs - The longest time to wait
+ * \returns 1 if bytes are waiting, 0 on timeout, -1 on error
+ */
+int waitReadable(int fd, uint32 timeoutMs)
+{
+    return waitReady(fd, POLLIN, (int)timeoutMs);
+}
+
+/**
+ * Reads len bytes from fd, giving up once timeoutMs has passed since the call began.
+ * \param fd - The file descriptor to read from
+ * \param[out] buf - The buffer to read into. Must hold at least len bytes.
+ * \param len - The number of bytes wanted
+ * \param timeoutMs - The deadline for the whole read, in milliseconds
+ * \returns The number of bytes read, which is less than len if the deadline passed or the port failed
+ */
+int pollRead(int fd, uint8_t *buf, int len, uint32 timeoutMs)
+{
+    uint64_t deadline = monotonicMs() + timeoutMs;
+    int length = 0;
+
+    while (length < len)
+    {
+        uint64_t now = monotonicMs();
+        if (now >= deadline)
+            break;
+        if (waitReady(fd, POLLIN, (int)(deadline - now)) <= 0)
+            break;
+
+        ssize_t got = read(fd, buf + length, (size_t)(len - length));
+        if (got > 0)
+            length += (int)got;
+        else if (got < 0 && errno != EINTR && errno != EAGAIN)
+            break;
+    }
+    return length;
+}
+
+/**
+ * Discards incoming bytes until the line has been quiet for quietMs, or maxMs has passed.
+ * \param fd - The file descriptor to drain
+ * \param quietMs - How long the line must be idle before it counts as drained
+ * \param maxMs - The deadline for the whole drain, so a chattering camera can't hold us here
+ * \returns The number of bytes discarded
+ */
+int pollDrain(int fd, uint32 quietMs, uint32 maxMs)
+{
+    uint64_t deadline = monotonicMs() + maxMs;
+    uint8_t scratch[64];
+    int discarded = 0;
+
+    for (;;)
+    {
+        uint64_t now = monotonicMs();
+        if (now >= deadline)
+            break;
+        uint64_t wait = deadline - now < quietMs ? deadline - now : quietMs;
+        if (waitReady(fd, POLLIN, (int)wait) <= 0)
+            break;
+
+        ssize_t got = read(fd, scratch, sizeof(scratch));
+        if (got > 0)
+            discarded += (int)got;
+        else if (got < 0 && errno != EINTR && errno != EAGAIN)
+            break;
+    }
+    return discarded;
+}
+
+/**
+ * Writes all of buf to fd, waiting for room if the descriptor is non-blocking, so a command goes out in one piece.
+ * \param fd - The file descriptor to write to
+ * \param buf - The bytes to send
+ * \param len - The number of bytes to send
+ * \param timeoutMs - The deadline for the whole write, in milliseconds
+ * \returns The number of bytes written, which is less than len if the deadline passed or the port failed
+ */
+int writeAll(int fd, const uint8_t *buf, int len, uint32 timeoutMs)
+{
+    uint64_t deadline = monotonicMs() + timeoutMs;
+    int length = 0;
+
+    while (length < len)
+    {
+        ssize_t put = write(fd, buf + length, (size_t)(len - length));
+        if (put > 0)
+        {
+            length += (int)put;
+            continue;
+        }
+        if (put < 0 && errno != EINTR && errno != EAGAIN)
+            break;
+
+        uint64_t now = monotonicMs();
+        if (now >= deadline || waitReady(fd, POLLOUT, (int)(deadline - now)) < 0)
+            break;
+    }
+    return length;
+}
@@ -0,0 +1,17 @@
+/**
+ * \file vc0706_serial.h
+ * \brief Header for deadline-based serial I/O on the camera's file descriptor
+ */
+#ifndef _vc0706_serial_h_
+#define _vc0706_serial_h_
+
+#include "vc0706.h"
+
+uint64_t monotonicMs(void);
+uint64_t monotonicUs(void);
+int waitReadable(int fd, uint32 timeoutMs);
+int pollRead(int fd, uint8_t *buf, int len, uint32 timeoutMs);
+int pollDrain(int fd, uint32 quietMs, uint32 maxMs);
+int writeAll(int fd, const uint8_t *buf, int len, uint32 timeoutMs);
+
+#endif
@@ -0,0 +1,606 @@
+/**
+ * \file vc0706_storage.c
+ * \brief The storage worker task that writes downloaded images to disk and announces them to TIM
+ *
+ * The capture task copies each downloaded chunk into a block from a pool that is allocated once at startup, and
+ * queues it here. Files are written and announced from this task, so the next frame can be triggered and downloaded
+ * while the previous one is still being stored. When the pool runs dry, capture waits for storage to catch up.
+ * Each block is run through the JPEG structure check and CRC32 as it's written, so a truncated or garbled frame is
+ * thrown away rather than announced, and TIM gets the checksum of every image it is told about. Frames that are nearly
+ * the same as their camera's last kept frame are deleted here too, before anything is announced (see vc0706_dedup.c).
+ * Room for each image is made in the catalog before its file is created (see vc0706_catalog.c).
+ *
+ * In segment format each camera's frames are appended to that camera's open segment instead of getting a file each
+ * (see vc0706_segment.c). A segment is announced to TIM once it's full, the format changes back, or storage has been
+ * idle for VC0706_SEGMENT_IDLE_MS. Frames in segments don't get thumbnails.
+ */
+#include "vc0706_storage.h"
+#include "vc0706_catalog.h"
+#include "vc0706_child.h"
+#include "vc0706_dedup.h"
+#include "vc0706_device.h"
+#include "vc0706_jpeg.h"
+#include "vc0706_segment.h"
+#include "vc0706_serial.h"
+#include "vc0706_thumb.h"
+#include "vc0706_timing.h"
+
+/** The image buffer pool */
+static uint8 VC0706_Pool[VC0706_POOL_BLOCKS][VC0706_CHUNK_SIZE];
+/** Queue holding the indices of free pool blocks */
+static uint32 VC0706_PoolFreeQueue;
+/** Queue of work for the storage task */
+static uint32 VC0706_StorageQueue;
+/** The task ID for VC0706_StorageTask */
+uint32 VC0706_StorageTaskID;
+
+/** Number of images successfully stored (drives the parallel photo count) */
+static unsigned int VC0706_ImagesStored = 0;
+
+/** Each camera's open segment, in segment format */
+static VC0706_SegmentWriter_t VC0706_Segments[VC0706_MAX_CAMERAS];
+/** Sequence number of each camera's next frame in segment format */
+static uint32 VC0706_FrameSeq[VC0706_MAX_CAMERAS];
+/** Number tried first when naming the next segment */
+static uint16 VC0706_NextSegment = 0;
+
+// External References
+extern char num_reboots[3];
+
+/**
+ * Creates the buffer pool, the work queue and the storage task.
+ * \returns The success value of the child task creation function call
+ * \sa #VC0706_ChildInit
+ */
+int VC0706_StorageInit(void)
+{
+    int32 result = OS_QueueCreate(&VC0706_PoolFreeQueue, "VC0706_POOL_Q", VC0706_POOL_BLOCKS, sizeof(uint16), 0);
+    if (result == OS_SUCCESS)
+        result = OS_QueueCreate(&VC0706_StorageQueue, "VC0706_STORE_Q", VC0706_STORAGE_QUEUE_DEPTH, sizeof(VC0706_StorageMsg_t), 0);
+    if (result != OS_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR,
+                          "Storage initialization error: queue create failed: result = %d", (int)result);
+        return result;
+    }
+
+    VC0706_JpegInit();
+
+    // Every block starts out free
+    uint16 block;
+    for (block = 0; block < VC0706_POOL_BLOCKS; block++)
+        OS_QueuePut(VC0706_PoolFreeQueue, &block, sizeof(block), 0);
+
+    result = CFE_ES_CreateChildTask(&VC0706_StorageTaskID,
+                                    VC0706_STORAGE_TASK_NAME,
+                                    (void *)VC0706_StorageTask, 0,
+                                    VC0706_STORAGE_TASK_STACK_SIZE,
+                                    VC0706_STORAGE_TASK_PRIORITY, 0);
+    if (result != CFE_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR,
+                          "Storage initialization error: create task failed: result = %d", (int)result);
+    }
+    return result;
+}
+
+/**
+ * Queues a message for the storage task, waiting for room if the queue is full.
+ * \returns 0 on success, -1 if the message could not be queued
+ */
+static int queueStorageMsg(VC0706_StorageMsg_t *msg)
+{
+    int tries;
+    for (tries = 0; tries < VC0706_POOL_WAIT_MS / 10; tries++)
+    {
+        if (OS_QueuePut(VC0706_StorageQueue, msg, sizeof(*msg), 0) == OS_SUCCESS)
+            return 0;
+        OS_TaskDelay(10);
+    }
+    CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "Storage queue full, dropping request %d", msg->op);
+    return -1;
+}
+
+/**
+ * Starts a new image file. Called by the capture task before downloading a frame.
+ * \param stream - The camera the image comes from
+ * \param path - The full path of the file to create
+ * \param len - The frame's length, as reported by the camera, so room can be made for it
+ * \param priority - The image's priority in the catalog; see the VC0706_PRIORITY_ values
+ * \returns 0 on success, -1 if the request could not be queued
+ */
+int VC0706_StorageBegin(int stream, const char *path, uint32 len, uint8 priority)
+{
+    VC0706_StorageMsg_t msg;
+    if (stream < 0 || stream >= VC0706_MAX_CAMERAS)
+        return -1;
+    memset(&msg, 0, sizeof(msg));
+    msg.op = VC0706_STORE_OPEN;
+    msg.stream = (uint8)stream;
+    msg.len = len;
+    msg.priority = priority;
+    snprintf(msg.path, sizeof(msg.path), "%s", path);
+    return queueStorageMsg(&msg);
+}
+
+/**
+ * Copies a downloaded chunk into a pool block and queues it for writing. Usable as a #ChunkSink_t.
+ * \param ctx - A pointer to the int stream (camera) the chunk belongs to
+ * \param data - The chunk to store
+ * \param len - The length of the chunk. At most VC0706_CHUNK_SIZE.
+ * \returns 0 on success, -1 if no pool block became free in time or the chunk could not be queued
+ */
+int VC0706_StorageWrite(void *ctx, const uint8_t *data, uint32 len)
+{
+    VC0706_StorageMsg_t msg;
+    uint32 size;
+    uint16 block;
+
+    if (len > VC0706_CHUNK_SIZE || *(int *)ctx < 0 || *(int *)ctx >= VC0706_MAX_CAMERAS)
+        return -1;
+
+    // Blocks until storage frees one up, which is what keeps memory bounded
+    if (OS_QueueGet(VC0706_PoolFreeQueue, &block, sizeof(block), &size, VC0706_POOL_WAIT_MS) != OS_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "No free image buffer after %d ms", VC0706_POOL_WAIT_MS);
+        return -1;
+    }
+
+    memcpy(VC0706_Pool[block], data, len);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.op = VC0706_STORE_WRITE;
+    msg.stream = (uint8)*(int *)ctx;
+    msg.block = block;
+    msg.len = len;
+    if (queueStorageMsg(&msg) == -1)
+    {
+        OS_QueuePut(VC0706_PoolFreeQueue, &block, sizeof(block), 0);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Finishes a camera's current image file.
+ * \param stream - The camera the image comes from
+ * \param keep - true to close and announce the file, false to delete it (e.g. after a failed download)
+ * \returns 0 on success, -1 if the request could not be queued
+ */
+int VC0706_StorageEnd(int stream, bool keep)
+{
+    VC0706_StorageMsg_t msg;
+    if (stream < 0 || stream >= VC0706_MAX_CAMERAS)
+        return -1;
+    memset(&msg, 0, sizeof(msg));
+    msg.op = keep ? VC0706_STORE_CLOSE : VC0706_STORE_ABORT;
+    msg.stream = (uint8)stream;
+    return queueStorageMsg(&msg);
+}
+
+/**
+ * Announces an image once its thumbnail has gone out. Called by the thumbnail workers.
+ * \param path - The image's full path
+ * \param crc - The image's CRC32
+ * \returns 0 on success, -1 if the request could not be queued
+ */
+int VC0706_StorageAnnounce(const char *path, uint32 crc)
+{
+    VC0706_StorageMsg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.op = VC0706_STORE_ANNOUNCE;
+    msg.crc = crc;
+    snprintf(msg.path, sizeof(msg.path), "%s", path);
+    return queueStorageMsg(&msg);
+}
+
+/**
+ * Saves a file's CRC32 next to it, as eight hex digits, so it can be checked again on the ground.
+ * \param path - The full path of the stored file
+ * \param crc - The file's CRC32
+ * \returns The number of bytes written, for the catalog
+ */
+uint32 VC0706_StorageWriteCrc(const char *path, uint32 crc)
+{
+    char crcPath[OS_MAX_PATH_LEN];
+    char text[10];
+
+    snprintf(crcPath, sizeof(crcPath), "%s%s", path, VC0706_CRC_SUFFIX);
+    int len = snprintf(text, sizeof(text), "%08x\n", (unsigned int)crc);
+
+    int32 fd = OS_creat(crcPath, (int32)OS_READ_WRITE);
+    if (fd < OS_FS_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "Could not create %s", crcPath);
+        return 0;
+    }
+    int32 written = OS_write(fd, text, (uint32)len);
+    if (written != len)
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "Could not write %s", crcPath);
+    OS_close(fd);
+    return written > 0 ? (uint32)written : 0;
+}
+
+/**
+ * Counts a stored image on the parallel photo count pins.
+ */
+static void countImage(void)
+{
+    // update number of pics taken on the parallel pins
+    VC0706_ImagesStored++;
+    updatePhotoCount((uint8)VC0706_ImagesStored);
+}
+
+/**
+ * Publishes a completed image: housekeeping filename, TIM notification and parallel photo count.
+ * \param path - The full path of the stored image
+ * \param crc - The image's CRC32
+ */
+static void announceImage(const char *path, uint32 crc)
+{
+    const char *file_name = strrchr(path, '/');
+    file_name = file_name != NULL ? file_name + 1 : path;
+
+    // Put Image name on telem packet
+    snprintf(VC0706_HkTelemetryPkt.vc0706_filename, sizeof(VC0706_HkTelemetryPkt.vc0706_filename), "%s", file_name);
+
+    uint64_t sentUs = monotonicUs();
+    VC0706_SendTimFileName((char *)file_name, crc);
+    VC0706_TimingRecord(VC0706_PHASE_NOTIFY, monotonicUs() - sentUs);
+
+    // From now on the image may be evicted to make room
+    VC0706_CatalogAnnounced(path);
+
+    countImage();
+}
+
+/**
+ * An image file being written by the storage task
+ */
+typedef struct
+{
+    char path[OS_MAX_PATH_LEN]; /**< The image's full path */
+    int32 fd;                   /**< The OSAL file descriptor, or -1 if not open */
+    bool failed;                /**< Set once anything goes wrong with this file */
+    bool reserved;              /**< Whether the catalog gave this file its path. If not, whatever is at the path is
+                                     another image's and is left alone. */
+    bool segment;               /**< Whether the image is being appended to its camera's segment, whose path is in path */
+    CFE_TIME_SysTime_t time;    /**< When the image was opened, for its segment record */
+    VC0706_JpegCheck_t check;   /**< JPEG structure check and CRC over the bytes written so far */
+} VC0706_OpenImage_t;
+
+/**
+ * Marks an image as failed because its bytes aren't a well-formed JPEG, so it's deleted rather than announced.
+ */
+static void rejectImage(VC0706_OpenImage_t *file)
+{
+    CFE_EVS_SendEvent(VC0706_IMAGE_ERR_EID, CFE_EVS_ERROR, "Image <%s> is not a complete JPEG (broken at byte %u of %u)",
+                      file->path, (unsigned int)file->check.badAt, (unsigned int)file->check.offset);
+    VC0706_CaptureTlmPkt.vc0706_frames_invalid++;
+    file->failed = true;
+}
+
+/**
+ * Closes a camera's open segment, if it has one, and announces it to TIM. An empty segment is deleted instead.
+ * \param stream - The camera whose segment to close
+ */
+static void sealSegment(int stream)
+{
+    VC0706_SegmentWriter_t *w = &VC0706_Segments[stream];
+    char indexPath[OS_MAX_PATH_LEN];
+
+    if (w->dataFd == -1)
+        return;
+
+    uint32 frames = w->frames;
+    uint32 crc = VC0706_SegmentSeal(w);
+    VC0706_CatalogStored(w->path, w->end + frames * sizeof(VC0706_SegmentRecord_t));
+    if (frames == 0)
+    {
+        VC0706_CatalogDrop(w->path);
+        OS_remove(w->path);
+        if (VC0706_SegmentIndexPath(w->path, indexPath, sizeof(indexPath)) == 0)
+            OS_remove(indexPath);
+        return;
+    }
+
+    const char *name = strrchr(w->path, '/');
+    name = name != NULL ? name + 1 : w->path;
+    uint64_t sentUs = monotonicUs();
+    VC0706_SendTimFileName((char *)name, crc);
+    VC0706_TimingRecord(VC0706_PHASE_NOTIFY, monotonicUs() - sentUs);
+
+    // From now on the segment may be evicted to make room
+    VC0706_CatalogAnnounced(w->path);
+    VC0706_CaptureTlmPkt.vc0706_segments_sealed++;
+}
+
+/**
+ * Starts appending an image to its camera's segment, sealing the segment first if the image won't fit and starting a
+ * new one if need be.
+ * \param file - The image
+ * \param stream - The camera the image comes from
+ * \param len - The image's length, as reported by the camera
+ * \param priority - The image's priority
+ * \returns 0 on success, -1 if the image can't be stored
+ */
+static int beginSegmentFrame(VC0706_OpenImage_t *file, int stream, uint32 len, uint8 priority)
+{
+    VC0706_SegmentWriter_t *w = &VC0706_Segments[stream];
+    char path[OS_MAX_PATH_LEN];
+    int tries;
+
+    file->segment = true;
+    if (w->dataFd != -1 && w->frames > 0 && (w->frames >= VC0706_SEGMENT_MAX_FRAMES || w->end + len > VC0706_SEGMENT_MAX_BYTES))
+        sealSegment(stream);
+
+    if (w->dataFd == -1)
+    {
+        // Names wrap at 9999; skip any still taken by segments that haven't been evicted
+        for (tries = 0; tries < 10000; tries++)
+        {
+            snprintf(path, sizeof(path), "%s/%.3s_%d_%.4u%s", VC0706_IMAGE_DIR, num_reboots, stream,
+                     (unsigned int)VC0706_NextSegment, VC0706_SEGMENT_EXT);
+            VC0706_NextSegment = (uint16)((VC0706_NextSegment + 1) % 10000);
+            if (!VC0706_CatalogHas(path))
+                break;
+        }
+        if (tries == 10000 || VC0706_SegmentCreate(w, path) != OS_FS_SUCCESS)
+        {
+            CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_ERROR, "SEGMENT FILE COULD NOT BE OPENED/MADE!");
+            return -1;
+        }
+    }
+    snprintf(file->path, sizeof(file->path), "%s", w->path);
+
+    // Room is made before anything is appended, so the RAM disk can't fill up part way through the frame
+    if (VC0706_CatalogExtend(w->path, len + sizeof(VC0706_SegmentRecord_t), priority) != 0)
+        return -1;
+    file->fd = w->dataFd;
+    file->time = CFE_TIME_GetTime();
+    return 0;
+}
+
+/**
+ * Finishes an image being appended to its camera's segment: adds it to the index if it's good, or writes the next
+ * frame over it if not.
+ * \param file - The image
+ * \param stream - The camera the image comes from
+ * \param keep - true if the download completed, false if it was abandoned
+ */
+static void endSegmentFrame(VC0706_OpenImage_t *file, int stream, bool keep)
+{
+    VC0706_SegmentWriter_t *w = &VC0706_Segments[stream];
+    VC0706_SegmentRecord_t rec;
+    bool stored = false;
+    uint32 crc;
+
+    // The segment stays open for the camera's next frame
+    file->fd = -1;
+
+    if (w->dataFd != -1)
+    {
+        if (keep && !file->failed)
+        {
+            if (!VC0706_JpegFinish(&file->check, &crc))
+            {
+                rejectImage(file);
+            }
+            else if (VC0706_DedupIsRepeat(stream, w->path, w->end))
+            {
+                VC0706_CaptureTlmPkt.vc0706_frames_repeated++;
+            }
+            else
+            {
+                memset(&rec, 0, sizeof(rec));
+                rec.Sequence = VC0706_FrameSeq[stream];
+                rec.Seconds = file->time.Seconds;
+                rec.Subseconds = file->time.Subseconds;
+                rec.Crc = crc;
+                rec.Camera = (uint8)stream;
+                stored = VC0706_SegmentCommit(w, &rec) == OS_FS_SUCCESS;
+                if (!stored)
+                {
+                    CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "SEGMENT INDEX WRITE FAILED! <%s>", w->path);
+                    file->failed = true;
+                }
+            }
+        }
+        bool cut = stored || VC0706_SegmentRewind(w) == OS_FS_SUCCESS;
+
+        // The reservation gives way to what the segment really takes up
+        VC0706_CatalogStored(w->path, w->end + w->frames * sizeof(VC0706_SegmentRecord_t));
+
+        // A frame that couldn't be cut off could outlast the next one, so no more go in this segment
+        if (!cut)
+        {
+            CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "SEGMENT TRUNCATE FAILED! <%s>", w->path);
+            sealSegment(stream);
+        }
+    }
+
+    if (stored)
+    {
+        VC0706_FrameSeq[stream]++;
+        VC0706_CaptureTlmPkt.vc0706_last_crc = crc;
+        const char *name = strrchr(w->path, '/');
+        snprintf(VC0706_HkTelemetryPkt.vc0706_filename, sizeof(VC0706_HkTelemetryPkt.vc0706_filename), "%s",
+                 name != NULL ? name + 1 : w->path);
+        countImage();
+    }
+    if (file->failed)
+        VC0706_SendTimFileName("error.txt", 0); // contains: "image failed to be taken."
+}
+
+/**
+ * The entry point for the storage task. Writes queued image data to disk until the app exits.
+ */
+void VC0706_StorageTask(void)
+{
+    VC0706_StorageMsg_t msg;
+    VC0706_OpenImage_t files[VC0706_MAX_CAMERAS];
+    VC0706_OpenImage_t *file;
+    uint32 size;
+    int i;
+
+    for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+    {
+        memset(files[i].path, '\0', sizeof(files[i].path));
+        files[i].fd = -1;
+        files[i].failed = false;
+        files[i].reserved = false;
+        files[i].segment = false;
+        VC0706_Segments[i].dataFd = -1;
+        VC0706_FrameSeq[i] = 0;
+    }
+
+    if (CFE_ES_RegisterChildTask() != CFE_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "Storage task register child failed");
+        CFE_ES_ExitChildTask();
+        return;
+    }
+
+    for (;;)
+    {
+        // With a segment open, wake up now and then so it's sealed and sent even if captures stop
+        bool segmentOpen = false;
+        for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+            segmentOpen = segmentOpen || VC0706_Segments[i].dataFd != -1;
+
+        int32 status = OS_QueueGet(VC0706_StorageQueue, &msg, sizeof(msg), &size, segmentOpen ? VC0706_SEGMENT_IDLE_MS : OS_PEND);
+        if (status == OS_QUEUE_TIMEOUT)
+        {
+            for (i = 0; i < VC0706_MAX_CAMERAS; i++)
+            {
+                if (files[i].fd == -1) // not part way through a frame
+                    sealSegment(i);
+            }
+        }
+        if (status != OS_SUCCESS)
+            continue;
+        if (msg.stream >= VC0706_MAX_CAMERAS)
+            continue;
+        file = &files[msg.stream];
+
+        switch (msg.op)
+        {
+        case VC0706_STORE_OPEN:
+            file->failed = false;
+            file->reserved = false;
+            file->segment = false;
+            VC0706_JpegBegin(&file->check);
+
+            if (VC0706_Config.storageFormat == VC0706_FORMAT_SEGMENTS)
+            {
+                if (beginSegmentFrame(file, msg.stream, msg.len, msg.priority) != 0)
+                {
+                    file->fd = -1;
+                    file->failed = true;
+                }
+                break;
+            }
+
+            // Back to a file per frame; send off whatever segment format left behind
+            sealSegment(msg.stream);
+            snprintf(file->path, sizeof(file->path), "%s", msg.path);
+
+            // Room is made before the file exists, so the RAM disk can't fill up part way through it
+            if (VC0706_CatalogReserve(file->path, msg.len, msg.priority) != 0)
+            {
+                file->fd = -1;
+                file->failed = true;
+                break;
+            }
+            file->reserved = true;
+            file->fd = OS_creat(file->path, (int32)OS_READ_WRITE);
+            if (file->fd < OS_FS_SUCCESS)
+            {
+                CFE_EVS_SendEvent(VC0706_CHILD_INIT_INF_EID, CFE_EVS_ERROR, "IMAGE FILE COULD NOT BE OPENED/MADE!");
+                file->fd = -1;
+                file->failed = true;
+            }
+            break;
+
+        case VC0706_STORE_WRITE:
+            if (!file->failed)
+            {
+                uint64_t writeUs = monotonicUs();
+                CFE_ES_PerfLogEntry(VC0706_WRITE_PERF_ID);
+                int32 written;
+                if (file->segment)
+                    written = VC0706_SegmentAppend(&VC0706_Segments[msg.stream], VC0706_Pool[msg.block], msg.len) == OS_FS_SUCCESS ? (int32)msg.len : OS_FS_ERROR;
+                else
+                    written = OS_write(file->fd, VC0706_Pool[msg.block], msg.len);
+                CFE_ES_PerfLogExit(VC0706_WRITE_PERF_ID);
+                if (written != (int32)msg.len)
+                {
+                    CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "IMAGE FILE WRITE FAILED! <%s>", file->path);
+                    file->failed = true;
+                }
+                VC0706_JpegFeed(&file->check, VC0706_Pool[msg.block], msg.len);
+                if (file->check.state == VC0706_JPEG_BAD)
+                    rejectImage(file); // no point writing the rest
+                VC0706_TimingRecord(VC0706_PHASE_WRITE, monotonicUs() - writeUs);
+            }
+            // Hand the block back to capture
+            OS_QueuePut(VC0706_PoolFreeQueue, &msg.block, sizeof(msg.block), 0);
+            break;
+
+        case VC0706_STORE_CLOSE:
+        case VC0706_STORE_ABORT:
+            if (file->segment)
+            {
+                endSegmentFrame(file, msg.stream, msg.op == VC0706_STORE_CLOSE);
+                break;
+            }
+            if (file->fd != -1)
+                OS_close(file->fd);
+            file->fd = -1;
+
+            if (msg.op == VC0706_STORE_CLOSE && !file->failed)
+            {
+                uint32 crc;
+                if (!VC0706_JpegFinish(&file->check, &crc))
+                {
+                    rejectImage(file);
+                }
+                else if (VC0706_DedupIsRepeat(msg.stream, file->path, 0))
+                {
+                    // Nothing new in the scene; the last frame kept from this camera already shows it
+                    VC0706_CaptureTlmPkt.vc0706_frames_repeated++;
+                    VC0706_CatalogDrop(file->path);
+                    OS_remove(file->path);
+                }
+                else
+                {
+                    VC0706_CatalogStored(file->path, file->check.offset + VC0706_StorageWriteCrc(file->path, crc));
+                    VC0706_CaptureTlmPkt.vc0706_last_crc = crc;
+
+                    // With thumbnails on, a worker announces the preview first and hands the image back
+                    if (!VC0706_Config.thumbnails || VC0706_ThumbQueue(file->path, crc) != 0)
+                        announceImage(file->path, crc);
+                }
+            }
+            if (msg.op != VC0706_STORE_CLOSE || file->failed)
+            {
+                // Don't leave a truncated image behind
+                if (file->reserved)
+                {
+                    VC0706_CatalogDrop(file->path);
+                    OS_remove(file->path);
+                }
+                if (file->failed)
+                    VC0706_SendTimFileName("error.txt", 0); // contains: "image failed to be taken."
+            }
+            break;
+
+        case VC0706_STORE_ANNOUNCE:
+            announceImage(msg.path, msg.crc);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
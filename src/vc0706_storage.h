@@ -0,0 +1,59 @@
+/**
+ * \file vc0706_storage.h
+ * \brief Header for the VC0706 storage worker task and its image buffer pool
+ */
+#ifndef _vc0706_storage_h_
+#define _vc0706_storage_h_
+
+#include "vc0706.h"
+#include "vc0706_thumb.h"
+
+/** Name for the VC0706 storage child task */
+#define VC0706_STORAGE_TASK_NAME "CAMERA_STORAGE"
+/** Number of bytes to allocate for the storage task's stack (8KB) */
+#define VC0706_STORAGE_TASK_STACK_SIZE 8192
+/** The CFE priority for the storage task. Lower than the capture task so the serial link is always serviced first. */
+#define VC0706_STORAGE_TASK_PRIORITY 205
+/** Number of chunk-sized blocks in the image buffer pool. Bounds how far storage may lag behind capture. */
+#define VC0706_POOL_BLOCKS 48
+/** Depth of the storage task's work queue. Room for every pool block, the open/close messages around them and the
+ *  announcements coming back from the thumbnail workers. */
+#define VC0706_STORAGE_QUEUE_DEPTH (VC0706_POOL_BLOCKS + 4 * VC0706_MAX_CAMERAS + VC0706_THUMB_QUEUE_DEPTH)
+/** Longest time in milliseconds capture will wait for a free pool block before giving up on a frame */
+#define VC0706_POOL_WAIT_MS 5000
+
+/**
+ * The kinds of work the storage task can be handed
+ */
+typedef enum
+{
+    VC0706_STORE_OPEN,  /**< Make room for and create a new image file */
+    VC0706_STORE_WRITE, /**< Append a pool block to the open image file */
+    VC0706_STORE_CLOSE, /**< Finish the open image file and announce it */
+    VC0706_STORE_ABORT, /**< Throw away the open image file */
+    VC0706_STORE_ANNOUNCE /**< Announce a stored image whose thumbnail has gone out */
+} VC0706_StorageOp_t;
+
+/**
+ * A unit of work for the storage task
+ */
+typedef struct
+{
+    uint8 op;                   /**< One of VC0706_StorageOp_t */
+    uint8 stream;               /**< The camera the work belongs to. Each camera has its own open file. */
+    uint16 block;               /**< The pool block holding the data, for VC0706_STORE_WRITE */
+    uint8 priority;             /**< The image's priority, for VC0706_STORE_OPEN */
+    uint32 len;                 /**< The number of valid bytes in the block for VC0706_STORE_WRITE, or the image's length for VC0706_STORE_OPEN */
+    uint32 crc;                 /**< The image's CRC32, for VC0706_STORE_ANNOUNCE */
+    char path[OS_MAX_PATH_LEN]; /**< The image's path, for VC0706_STORE_OPEN and VC0706_STORE_ANNOUNCE */
+} VC0706_StorageMsg_t;
+
+int VC0706_StorageInit(void);
+void VC0706_StorageTask(void);
+int VC0706_StorageBegin(int stream, const char *path, uint32 len, uint8 priority);
+int VC0706_StorageWrite(void *ctx, const uint8_t *data, uint32 len);
+int VC0706_StorageEnd(int stream, bool keep);
+int VC0706_StorageAnnounce(const char *path, uint32 crc);
+uint32 VC0706_StorageWriteCrc(const char *path, uint32 crc);
+
+#endif
@@ -0,0 +1,627 @@
+/**
+ * \file vc0706_thumb.c
+ * \brief Thumbnail worker tasks that make preview images of stored frames
+ *
+ * When thumbnails are switched on, the storage task hands each validated image to a pool of worker tasks instead of
+ * announcing it. A worker decodes only the DC coefficient of each luma block, which is the block's average
+ * brightness, so the image comes out at 1/8 of its size without any inverse DCT. The AC coefficients still have to be
+ * Huffman-decoded to find the next block, but nothing is done with them. The thumbnail is written beside the image as
+ * a greyscale PGM and announced to TIM, and then the full image is announced through the storage task. Ground can
+ * triage frames from their previews and only ask for the full frames worth the downlink.
+ *
+ * Only baseline (SOF0/SOF1) JPEGs with every component in one scan, which is what the VC0706 produces, are decoded.
+ */
+#include "vc0706_thumb.h"
+#include "vc0706_catalog.h"
+#include "vc0706_child.h"
+#include "vc0706_jpeg.h"
+#include "vc0706_serial.h"
+#include "vc0706_storage.h"
+#include "vc0706_timing.h"
+
+/** Queue of images waiting for thumbnails */
+static uint32 VC0706_ThumbJobQueue;
+/** The task IDs for the thumbnail workers */
+uint32 VC0706_ThumbTaskIDs[VC0706_THUMB_WORKERS];
+
+/**
+ * Creates the job queue and the worker tasks.
+ * \returns CFE_SUCCESS, or the error from the first thing that failed
+ */
+int VC0706_ThumbInit(void)
+{
+    char name[OS_MAX_API_NAME];
+    int32 result;
+    int i;
+
+    result = OS_QueueCreate(&VC0706_ThumbJobQueue, "VC0706_THUMB_Q", VC0706_THUMB_QUEUE_DEPTH, sizeof(VC0706_ThumbJob_t), 0);
+    if (result != OS_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR,
+                          "Thumbnail initialization error: queue create failed: result = %d", (int)result);
+        return result;
+    }
+
+    // Several workers, so the scheduler can spread previews over the cores capture isn't using
+    for (i = 0; i < VC0706_THUMB_WORKERS; i++)
+    {
+        snprintf(name, sizeof(name), "%s%d", VC0706_THUMB_TASK_NAME, i);
+        result = CFE_ES_CreateChildTask(&VC0706_ThumbTaskIDs[i], name, (void *)VC0706_ThumbTask, 0,
+                                        VC0706_THUMB_TASK_STACK_SIZE, VC0706_THUMB_TASK_PRIORITY, 0);
+        if (result != CFE_SUCCESS)
+        {
+            CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR,
+                              "Thumbnail initialization error: create task %s failed: result = %d", name, (int)result);
+            return result;
+        }
+    }
+    return CFE_SUCCESS;
+}
+
+/**
+ * Hands a stored image to the workers. Called by the storage task in place of announcing the image.
+ * \param path - The image's full path
+ * \param crc - The image's CRC32
+ * \returns 0 if a worker will announce the image, -1 if the caller must announce it (e.g. the queue is full)
+ */
+int VC0706_ThumbQueue(const char *path, uint32 crc)
+{
+    VC0706_ThumbJob_t job;
+
+    memset(&job, 0, sizeof(job));
+    snprintf(job.path, sizeof(job.path), "%s", path);
+    job.crc = crc;
+    if (OS_QueuePut(VC0706_ThumbJobQueue, &job, sizeof(job), 0) != OS_SUCCESS)
+    {
+        VC0706_CaptureTlmPkt.vc0706_thumbs_failed++;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Gets the next byte of the file.
+ * \returns The byte, or -1 once the file has run out
+ */
+static int nextByte(VC0706_ThumbDecoder_t *d)
+{
+    if (d->pos == d->len)
+    {
+        int32 got = d->eof ? 0 : OS_read(d->fd, d->buf, sizeof(d->buf));
+        if (got <= 0)
+        {
+            d->eof = true;
+            return -1;
+        }
+        d->pos = 0;
+        d->len = (uint32)got;
+    }
+    return d->buf[d->pos++];
+}
+
+/**
+ * Gets a big-endian 16-bit value from the file.
+ * \returns The value, or -1 once the file has run out
+ */
+static int32 nextWord(VC0706_ThumbDecoder_t *d)
+{
+    int hi = nextByte(d);
+    int lo = nextByte(d);
+    return hi < 0 || lo < 0 ? -1 : (hi << 8) | lo;
+}
+
+/**
+ * Gets the next bit of entropy-coded scan data, removing byte stuffing. Reads as zeros once a marker is reached.
+ */
+static int nextBit(VC0706_ThumbDecoder_t *d)
+{
+    if (d->bitsLeft == 0)
+    {
+        int b = d->marker ? 0 : nextByte(d);
+        if (b == 0xFF)
+        {
+            int code = nextByte(d);
+            if (code != 0x00)
+            {
+                // A marker: the scan (or this restart interval) is over
+                d->marker = true;
+                b = 0;
+            }
+        }
+        d->bitBuf = (uint8)(b < 0 ? 0 : b);
+        d->bitsLeft = 8;
+    }
+    d->bitsLeft--;
+    return (d->bitBuf >> d->bitsLeft) & 1;
+}
+
+/**
+ * Gets the next n bits of scan data, most significant first.
+ */
+static int32 nextBits(VC0706_ThumbDecoder_t *d, int n)
+{
+    int32 v = 0;
+    while (n-- > 0)
+        v = (v << 1) | nextBit(d);
+    return v;
+}
+
+/**
+ * Decodes one Huffman-coded symbol.
+ * \returns The symbol, or -1 if the bits match no code
+ */
+static int decodeSymbol(VC0706_ThumbDecoder_t *d, const VC0706_Huffman_t *h)
+{
+    int32 code = nextBit(d);
+    int l;
+
+    for (l = 1; l <= 16; l++)
+    {
+        if (h->maxcode[l] >= 0 && code <= h->maxcode[l])
+            return h->symbols[h->valptr[l] + code - h->mincode[l]];
+        code = (code << 1) | nextBit(d);
+    }
+    return -1;
+}
+
+/**
+ * Reads a DHT segment into the decoder's tables.
+ * \returns 0 on success, -1 if the segment is malformed
+ */
+static int readHuffmanTables(VC0706_ThumbDecoder_t *d, int32 segLen)
+{
+    int32 left = segLen - 2;
+
+    while (left > 0)
+    {
+        uint8 counts[16];
+        int tcth = nextByte(d);
+        int total = 0;
+        int l, i;
+
+        if (tcth < 0 || (tcth >> 4) > 1 || (tcth & 0x0F) > 3)
+            return -1;
+        VC0706_Huffman_t *h = (tcth >> 4) == 0 ? &d->dc[tcth & 0x0F] : &d->ac[tcth & 0x0F];
+
+        for (l = 0; l < 16; l++)
+        {
+            int c = nextByte(d);
+            if (c < 0)
+                return -1;
+            counts[l] = (uint8)c;
+            total += c;
+        }
+        if (total > 256 || 17 + total > left)
+            return -1;
+        for (i = 0; i < total; i++)
+        {
+            int s = nextByte(d);
+            if (s < 0)
+                return -1;
+            h->symbols[i] = (uint8)s;
+        }
+
+        // Canonical codes: each length's codes follow on from the last length's, shifted up a bit
+        int32 code = 0;
+        int k = 0;
+        for (l = 1; l <= 16; l++)
+        {
+            h->valptr[l] = k;
+            h->mincode[l] = code;
+            code += counts[l - 1];
+            k += counts[l - 1];
+            h->maxcode[l] = counts[l - 1] > 0 ? code - 1 : -1;
+            code <<= 1;
+        }
+        h->defined = true;
+        left -= 17 + total;
+    }
+    return left == 0 ? 0 : -1;
+}
+
+/**
+ * Reads a DQT segment, keeping only the DC entry of each table.
+ * \returns 0 on success, -1 if the segment is malformed
+ */
+static int readQuantTables(VC0706_ThumbDecoder_t *d, int32 segLen)
+{
+    int32 left = segLen - 2;
+
+    while (left > 0)
+    {
+        int pqtq = nextByte(d);
+        if (pqtq < 0 || (pqtq & 0x0F) > 3)
+            return -1;
+        bool wide = (pqtq >> 4) != 0;
+        int32 q = wide ? nextWord(d) : nextByte(d);
+        int skip = wide ? 126 : 63;
+        if (q < 0)
+            return -1;
+        d->q0[pqtq & 0x0F] = (uint16)q;
+        while (skip-- > 0)
+        {
+            if (nextByte(d) < 0)
+                return -1;
+        }
+        left -= wide ? 129 : 65;
+    }
+    return left == 0 ? 0 : -1;
+}
+
+/**
+ * Reads a baseline frame header.
+ * \returns 0 on success, -1 if the frame is malformed or too big for a thumbnail
+ */
+static int readFrameHeader(VC0706_ThumbDecoder_t *d)
+{
+    int i;
+
+    if (nextByte(d) != 8) // sample precision
+        return -1;
+    int32 height = nextWord(d);
+    int32 width = nextWord(d);
+    int count = nextByte(d);
+    if (height <= 0 || width <= 0 || count < 1 || count > VC0706_THUMB_MAX_COMPONENTS)
+        return -1;
+
+    d->height = (uint16)height;
+    d->width = (uint16)width;
+    d->compCount = (uint8)count;
+    for (i = 0; i < count; i++)
+    {
+        VC0706_Component_t *c = &d->comp[i];
+        int id = nextByte(d);
+        int hv = nextByte(d);
+        int tq = nextByte(d);
+        if (id < 0 || hv < 0 || tq < 0 || (hv >> 4) < 1 || (hv >> 4) > 4 || (hv & 0x0F) < 1 || (hv & 0x0F) > 4 || tq > 3)
+            return -1;
+        c->id = (uint8)id;
+        c->h = (uint8)(hv >> 4);
+        c->v = (uint8)(hv & 0x0F);
+        c->tq = (uint8)tq;
+    }
+    return 0;
+}
+
+/**
+ * Reads a scan header and matches its components to the frame's.
+ * \returns 0 on success, -1 if the scan isn't one this decoder handles
+ */
+static int readScanHeader(VC0706_ThumbDecoder_t *d)
+{
+    int count = nextByte(d);
+    int i, j;
+
+    // Every component in the one scan, as a baseline camera writes it
+    if (count != d->compCount)
+        return -1;
+    for (i = 0; i < count; i++)
+    {
+        int id = nextByte(d);
+        int tables = nextByte(d);
+        if (id != d->comp[i].id || tables < 0 || (tables >> 4) > 3 || (tables & 0x0F) > 3)
+            return -1;
+        d->comp[i].td = (uint8)(tables >> 4);
+        d->comp[i].ta = (uint8)(tables & 0x0F);
+        if (!d->dc[d->comp[i].td].defined || !d->ac[d->comp[i].ta].defined)
+            return -1;
+    }
+    for (j = 0; j < 3; j++) // spectral selection and successive approximation don't apply to baseline
+    {
+        if (nextByte(d) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * Decodes one 8x8 block, keeping only its DC coefficient.
+ * \returns The component's new DC value (dequantized), or INT32_MIN if the data is corrupt
+ */
+static int32 decodeBlock(VC0706_ThumbDecoder_t *d, VC0706_Component_t *c)
+{
+    int s = decodeSymbol(d, &d->dc[c->td]);
+    int k;
+
+    if (s < 0 || s > 11)
+        return INT32_MIN;
+    if (s > 0)
+    {
+        int32 diff = nextBits(d, s);
+        if (diff < (1 << (s - 1)))
+            diff += 1 - (1 << s);
+        c->pred += diff;
+    }
+
+    // Walk past the AC coefficients without keeping them
+    for (k = 1; k < 64;)
+    {
+        int rs = decodeSymbol(d, &d->ac[c->ta]);
+        if (rs < 0)
+            return INT32_MIN;
+        if ((rs & 0x0F) == 0)
+        {
+            if (rs != 0xF0)
+                break; // end of block
+            k += 16;
+            continue;
+        }
+        nextBits(d, rs & 0x0F);
+        k += (rs >> 4) + 1;
+    }
+    return c->pred * d->q0[c->tq];
+}
+
+/**
+ * Skips to the restart marker that ends the current interval and resets the DC predictors.
+ * \returns 0 on success, -1 if the file ran out first
+ */
+static int restart(VC0706_ThumbDecoder_t *d)
+{
+    int i;
+
+    d->bitsLeft = 0;
+    if (!d->marker)
+    {
+        // Find the marker the bits stopped short of
+        int b = nextByte(d);
+        for (;;)
+        {
+            if (b < 0)
+                return -1;
+            if (b != 0xFF)
+            {
+                b = nextByte(d);
+                continue;
+            }
+            b = nextByte(d);
+            if (b >= 0xD0 && b <= 0xD7)
+                break;
+        }
+    }
+    d->marker = false;
+    for (i = 0; i < d->compCount; i++)
+        d->comp[i].pred = 0;
+    return 0;
+}
+
+/**
+ * Decodes the scan, writing each luma block's average into the thumbnail.
+ * \returns 0 on success, -1 if the scan is corrupt
+ */
+static int decodeScan(VC0706_ThumbDecoder_t *d)
+{
+    uint8 hmax = 1, vmax = 1;
+    int i;
+
+    for (i = 0; i < d->compCount; i++)
+    {
+        if (d->comp[i].h > hmax)
+            hmax = d->comp[i].h;
+        if (d->comp[i].v > vmax)
+            vmax = d->comp[i].v;
+        d->comp[i].pred = 0;
+    }
+
+    // The first component is luma; one thumbnail pixel per luma block
+    const VC0706_Component_t *y = &d->comp[0];
+    uint32 mcusX = (d->width + 8 * hmax - 1) / (8 * hmax);
+    uint32 mcusY = (d->height + 8 * vmax - 1) / (8 * vmax);
+    d->thumbWidth = (uint16)((d->width * y->h / hmax + 7) / 8);
+    d->thumbHeight = (uint16)((d->height * y->v / vmax + 7) / 8);
+    if (mcusX * y->h > VC0706_THUMB_MAX_DIM || mcusY * y->v > VC0706_THUMB_MAX_DIM)
+        return -1;
+
+    uint32 mcu = 0;
+    uint32 mx, my;
+    for (my = 0; my < mcusY; my++)
+    {
+        for (mx = 0; mx < mcusX; mx++, mcu++)
+        {
+            if (d->restartInterval > 0 && mcu > 0 && mcu % d->restartInterval == 0 && restart(d) != 0)
+                return -1;
+
+            int ci;
+            for (ci = 0; ci < d->compCount; ci++)
+            {
+                VC0706_Component_t *c = &d->comp[ci];
+                uint32 bx, by;
+                for (by = 0; by < c->v; by++)
+                {
+                    for (bx = 0; bx < c->h; bx++)
+                    {
+                        int32 dc = decodeBlock(d, c);
+                        if (dc == INT32_MIN)
+                            return -1;
+                        if (ci != 0)
+                            continue;
+
+                        // The DC coefficient is eight times the block's mean, centred on zero
+                        uint32 px = mx * c->h + bx;
+                        uint32 py = my * c->v + by;
+                        int32 value = 128 + dc / 8;
+                        if (px < d->thumbWidth && py < d->thumbHeight)
+                            d->pixels[py * d->thumbWidth + px] = (uint8)(value < 0 ? 0 : value > 255 ? 255 : value);
+                    }
+                }
+            }
+            if (d->eof)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Decodes an image's luma DC coefficients into a thumbnail.
+ * \returns 0 on success, -1 if the image isn't a baseline JPEG this decoder can read
+ */
+static int decodeThumbnail(VC0706_ThumbDecoder_t *d)
+{
+    bool haveFrame = false;
+
+    if (nextByte(d) != 0xFF || nextByte(d) != 0xD8)
+        return -1;
+
+    for (;;)
+    {
+        int code;
+        if (nextByte(d) != 0xFF)
+            return -1;
+        while ((code = nextByte(d)) == 0xFF) // fill bytes
+            ;
+        if (code < 0 || code == 0xD9)
+            return -1; // no scan
+
+        int32 segLen = nextWord(d);
+        if (segLen < 2)
+            return -1;
+
+        int status = 0;
+        switch (code)
+        {
+        case 0xC0: // baseline
+        case 0xC1: // extended sequential, Huffman
+            status = readFrameHeader(d);
+            haveFrame = status == 0;
+            break;
+        case 0xC4:
+            status = readHuffmanTables(d, segLen);
+            break;
+        case 0xDB:
+            status = readQuantTables(d, segLen);
+            break;
+        case 0xDD:
+            status = segLen == 4 ? 0 : -1;
+            d->restartInterval = (uint16)nextWord(d);
+            break;
+        case 0xDA:
+            if (!haveFrame || readScanHeader(d) != 0)
+                return -1;
+            return decodeScan(d);
+        default:
+            // Progressive, lossless and arithmetic-coded frames aren't supported
+            if (code >= 0xC2 && code <= 0xCF && code != 0xC4 && code != 0xC8 && code != 0xCC)
+                return -1;
+            while (segLen-- > 2)
+            {
+                if (nextByte(d) < 0)
+                    return -1;
+            }
+            break;
+        }
+        if (status != 0)
+            return -1;
+    }
+}
+
+/**
+ * Decodes a stored image's luma DC coefficients into d->pixels, one pixel per 8x8 block.
+ * \param d - Decoder state. Large, so callers keep it off small task stacks.
+ * \param path - The full path of the file holding the image
+ * \param offset - Where the image starts in the file: 0 for a single image, the frame's offset within a segment
+ * \returns 0 on success, -1 if the image can't be read or isn't a baseline JPEG this decoder handles
+ */
+int VC0706_ThumbDecode(VC0706_ThumbDecoder_t *d, const char *path, uint32 offset)
+{
+    memset(d, 0, sizeof(*d));
+    d->fd = OS_open(path, OS_READ_ONLY, 0);
+    if (d->fd < 0)
+        return -1;
+    int status = offset == 0 || OS_lseek(d->fd, (int32)offset, OS_SEEK_SET) == (int32)offset ? decodeThumbnail(d) : -1;
+    OS_close(d->fd);
+    return status;
+}
+
+/**
+ * Works out where an image's thumbnail goes: the same name as the image with the thumbnail extension, so TIM can pair
+ * them up.
+ * \param path - The image's full path
+ * \param thumbPath - Where to put the thumbnail's full path
+ * \param size - The size of thumbPath
+ * \returns 0 on success, -1 if the image has no extension or the thumbnail's path doesn't fit
+ */
+int VC0706_ThumbPath(const char *path, char *thumbPath, size_t size)
+{
+    snprintf(thumbPath, size, "%s", path);
+    char *dot = strrchr(thumbPath, '.');
+    if (dot == NULL || (size_t)(dot - thumbPath) + sizeof(VC0706_THUMB_EXT) > size)
+        return -1;
+    snprintf(dot, size - (size_t)(dot - thumbPath), "%s", VC0706_THUMB_EXT);
+    return 0;
+}
+
+/**
+ * Makes the thumbnail for one image, writes it beside the image, and announces it.
+ * \returns 0 on success, -1 if no thumbnail was made
+ */
+static int makeThumbnail(VC0706_ThumbDecoder_t *d, const char *path)
+{
+    char thumbPath[OS_MAX_PATH_LEN];
+    char header[20];
+
+    if (VC0706_ThumbDecode(d, path, 0) != 0)
+        return -1;
+
+    if (VC0706_ThumbPath(path, thumbPath, sizeof(thumbPath)) != 0)
+        return -1;
+
+    int headerLen = snprintf(header, sizeof(header), "P5\n%u %u\n255\n", d->thumbWidth, d->thumbHeight);
+    uint32 pixelLen = (uint32)d->thumbWidth * d->thumbHeight;
+
+    int32 fd = OS_creat(thumbPath, (int32)OS_READ_WRITE);
+    if (fd < 0)
+        return -1;
+    bool written = OS_write(fd, header, (uint32)headerLen) == headerLen && OS_write(fd, d->pixels, pixelLen) == (int32)pixelLen;
+    OS_close(fd);
+    if (!written)
+    {
+        OS_remove(thumbPath);
+        return -1;
+    }
+
+    uint32 crc = VC0706_Crc32(0xFFFFFFFFu, (const uint8 *)header, (uint32)headerLen);
+    crc = ~VC0706_Crc32(crc, d->pixels, pixelLen);
+    uint32 crcLen = VC0706_StorageWriteCrc(thumbPath, crc);
+    VC0706_CatalogGrow(path, (uint32)headerLen + pixelLen + crcLen);
+
+    VC0706_CaptureTlmPkt.vc0706_thumbs_made++;
+    VC0706_CaptureTlmPkt.vc0706_thumb_bytes += (uint32)headerLen + pixelLen;
+    const char *name = strrchr(thumbPath, '/');
+    VC0706_SendTimFileName((char *)(name != NULL ? name + 1 : thumbPath), crc);
+    return 0;
+}
+
+/**
+ * The entry point for a thumbnail worker. Makes previews of queued images until the app exits.
+ */
+void VC0706_ThumbTask(void)
+{
+    VC0706_ThumbDecoder_t decoder;
+    VC0706_ThumbJob_t job;
+    uint32 size;
+
+    if (CFE_ES_RegisterChildTask() != CFE_SUCCESS)
+    {
+        CFE_EVS_SendEvent(VC0706_CHILD_INIT_ERR_EID, CFE_EVS_ERROR, "Thumbnail task register child failed");
+        CFE_ES_ExitChildTask();
+        return;
+    }
+
+    for (;;)
+    {
+        if (OS_QueueGet(VC0706_ThumbJobQueue, &job, sizeof(job), &size, OS_PEND) != OS_SUCCESS)
+            continue;
+
+        uint64_t startUs = monotonicUs();
+        if (makeThumbnail(&decoder, job.path) != 0)
+        {
+            VC0706_CaptureTlmPkt.vc0706_thumbs_failed++;
+            CFE_EVS_SendEvent(VC0706_IMAGE_ERR_EID, CFE_EVS_ERROR, "No thumbnail for <%s>", job.path);
+        }
+        VC0706_TimingRecord(VC0706_PHASE_THUMB, monotonicUs() - startUs);
+
+        // The preview goes out first; the full image follows through the storage task
+        VC0706_StorageAnnounce(job.path, job.crc);
+    }
+}
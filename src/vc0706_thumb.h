@@ -0,0 +1,97 @@
+/**
+ * \file vc0706_thumb.h
+ * \brief Header for the thumbnail worker tasks that make preview images of stored frames
+ */
+#ifndef _vc0706_thumb_h_
+#define _vc0706_thumb_h_
+
+#include "vc0706.h"
+
+/** Number of thumbnail worker tasks. The Pi has four cores, and capture and storage keep one of them busy. */
+#define VC0706_THUMB_WORKERS 3
+/** Base name for the thumbnail worker tasks; the worker number is appended */
+#define VC0706_THUMB_TASK_NAME "CAMERA_THUMB"
+/** Number of bytes to allocate for each worker's stack (32KB). Decoder state and the thumbnail live on it. */
+#define VC0706_THUMB_TASK_STACK_SIZE 32768
+/** The CFE priority for the thumbnail workers. Lowest of the app's tasks; previews never hold up a capture. */
+#define VC0706_THUMB_TASK_PRIORITY 210
+/** Depth of the thumbnail job queue. Images that don't fit are announced without a thumbnail. */
+#define VC0706_THUMB_QUEUE_DEPTH (2 * VC0706_MAX_CAMERAS)
+/** Largest thumbnail side in pixels. Thumbnails are 1/8 of the image's size, so this covers up to 1024x1024. */
+#define VC0706_THUMB_MAX_DIM 128
+/** Bytes of the image read from disk at a time while decoding */
+#define VC0706_THUMB_READ_SIZE 1024
+/** Extension given to thumbnails in place of the image's .jpg. Thumbnails are 8-bit greyscale binary PGM. */
+#define VC0706_THUMB_EXT ".pgm"
+
+/** Most components a decoded image may have */
+#define VC0706_THUMB_MAX_COMPONENTS 3
+
+/**
+ * A Huffman table, arranged for decoding a code a bit at a time (ITU T.81 F.2.2.3)
+ */
+typedef struct
+{
+    uint8 symbols[256]; /**< The symbols, in order of code length */
+    int32 maxcode[17];  /**< Largest code of each length, or -1 if there are none */
+    int32 mincode[17];  /**< Smallest code of each length */
+    int32 valptr[17];   /**< Index into symbols of the smallest code of each length */
+    bool defined;       /**< Whether the image defined this table */
+} VC0706_Huffman_t;
+
+/**
+ * An image component, as declared by the frame header
+ */
+typedef struct
+{
+    uint8 id; /**< Component identifier used by the scan header */
+    uint8 h;  /**< Horizontal sampling factor */
+    uint8 v;  /**< Vertical sampling factor */
+    uint8 tq; /**< Quantization table */
+    uint8 td; /**< DC Huffman table, from the scan header */
+    uint8 ta; /**< AC Huffman table, from the scan header */
+    int32 pred; /**< DC predictor */
+} VC0706_Component_t;
+
+/**
+ * Everything a worker needs to decode one image
+ */
+typedef struct
+{
+    int32 fd;                                   /**< The image file */
+    uint8 buf[VC0706_THUMB_READ_SIZE];          /**< Read buffer */
+    uint32 pos;                                 /**< Next byte of buf to use */
+    uint32 len;                                 /**< Valid bytes in buf */
+    uint8 bitBuf;                               /**< Scan byte being consumed a bit at a time */
+    uint8 bitsLeft;                             /**< Bits of bitBuf not yet consumed */
+    bool marker;                                /**< Whether the scan data has run into a marker */
+    bool eof;                                   /**< Whether the file ran out */
+    VC0706_Huffman_t dc[4];                     /**< DC Huffman tables */
+    VC0706_Huffman_t ac[4];                     /**< AC Huffman tables */
+    uint16 q0[4];                               /**< DC entry of each quantization table */
+    VC0706_Component_t comp[VC0706_THUMB_MAX_COMPONENTS]; /**< The image's components */
+    uint8 compCount;                            /**< Number of components */
+    uint16 width;                               /**< Image width in pixels */
+    uint16 height;                              /**< Image height in pixels */
+    uint16 restartInterval;                     /**< MCUs between restart markers, or 0 */
+    uint8 pixels[VC0706_THUMB_MAX_DIM * VC0706_THUMB_MAX_DIM]; /**< The thumbnail */
+    uint16 thumbWidth;                          /**< Thumbnail width in pixels */
+    uint16 thumbHeight;                         /**< Thumbnail height in pixels */
+} VC0706_ThumbDecoder_t;
+
+/**
+ * A stored image waiting for its thumbnail
+ */
+typedef struct
+{
+    char path[OS_MAX_PATH_LEN]; /**< The image's full path */
+    uint32 crc;                 /**< The image's CRC32, passed on when the image is announced */
+} VC0706_ThumbJob_t;
+
+int VC0706_ThumbInit(void);
+void VC0706_ThumbTask(void);
+int VC0706_ThumbQueue(const char *path, uint32 crc);
+int VC0706_ThumbDecode(VC0706_ThumbDecoder_t *d, const char *path, uint32 offset);
+int VC0706_ThumbPath(const char *path, char *thumbPath, size_t size);
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * \file vc0706_timing.c
+ * \brief Keeps recent timings for each phase of a capture, for housekeeping percentiles and CSV dumps
+ *
+ * The capture and storage tasks record how long each phase of a capture took. The most recent
+ * VC0706_TIMING_SAMPLES samples of each phase are kept so housekeeping can report percentiles, showing where the
+ * time per frame goes when tuning timeouts and chunk sizes.
+ */
+#include <stdlib.h>
+#include "vc0706_timing.h"
+
+/** Names of the phases, in VC0706_PHASE_ order, as written to the CSV */
+static const char *VC0706_PhaseNames[VC0706_PHASE_COUNT] = {
+    "setup", "freeze", "length", "chunk", "tail", "write", "notify", "frame", "thumb", "dedup",
+};
+
+/** Recent samples of each phase, in microseconds, as rings */
+static uint32 VC0706_TimingRing[VC0706_PHASE_COUNT][VC0706_TIMING_SAMPLES];
+/** Samples recorded for each phase since the last reset. The ring holds the newest VC0706_TIMING_SAMPLES of them. */
+static uint32 VC0706_TimingCount[VC0706_PHASE_COUNT];
+/** Guards the rings, which are filled by the capture and storage tasks and read by the main task */
+static uint32 VC0706_TimingMutex;
+
+/**
+ * Creates the mutex guarding the samples. Must run before any task records a sample.
+ * \returns OS_SUCCESS, or the OSAL error code
+ */
+int32 VC0706_TimingInit(void)
+{
+    memset(VC0706_TimingRing, 0, sizeof(VC0706_TimingRing));
+    memset(VC0706_TimingCount, 0, sizeof(VC0706_TimingCount));
+    return OS_MutSemCreate(&VC0706_TimingMutex, "VC0706_TIMING", 0);
+}
+
+/**
+ * Records how long one occurrence of a phase took.
+ * \param phase - One of the VC0706_PHASE_ values
+ * \param us - The duration in microseconds
+ */
+void VC0706_TimingRecord(uint8 phase, uint64_t us)
+{
+    if (phase >= VC0706_PHASE_COUNT)
+        return;
+
+    OS_MutSemTake(VC0706_TimingMutex);
+    VC0706_TimingRing[phase][VC0706_TimingCount[phase] % VC0706_TIMING_SAMPLES] = us > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32)us;
+    VC0706_TimingCount[phase]++;
+    OS_MutSemGive(VC0706_TimingMutex);
+}
+
+/**
+ * qsort() comparison for uint32 samples
+ */
+static int compareSamples(const void *a, const void *b)
+{
+    uint32 x = *(const uint32 *)a;
+    uint32 y = *(const uint32 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Works out the percentiles of a phase's recent samples.
+ * \param phase - One of the VC0706_PHASE_ values
+ * \param[out] stats - The summary. All zero if the phase has no samples.
+ */
+void VC0706_TimingSummary(uint8 phase, VC0706_TimingStats_t *stats)
+{
+    uint32 sorted[VC0706_TIMING_SAMPLES];
+
+    memset(stats, 0, sizeof(*stats));
+    if (phase >= VC0706_PHASE_COUNT)
+        return;
+
+    OS_MutSemTake(VC0706_TimingMutex);
+    uint32 n = VC0706_TimingCount[phase] < VC0706_TIMING_SAMPLES ? VC0706_TimingCount[phase] : VC0706_TIMING_SAMPLES;
+    memcpy(sorted, VC0706_TimingRing[phase], n * sizeof(sorted[0]));
+    OS_MutSemGive(VC0706_TimingMutex);
+
+    if (n == 0)
+        return;
+
+    // Sort outside the lock so the capture path never waits on it
+    qsort(sorted, n, sizeof(sorted[0]), compareSamples);
+    stats->samples = n;
+    stats->p50Us = sorted[(n - 1) * 50 / 100];
+    stats->p90Us = sorted[(n - 1) * 90 / 100];
+    stats->p99Us = sorted[(n - 1) * 99 / 100];
+    stats->maxUs = sorted[n - 1];
+}
+
+/**
+ * Throws away every sample.
+ */
+void VC0706_TimingReset(void)
+{
+    OS_MutSemTake(VC0706_TimingMutex);
+    memset(VC0706_TimingCount, 0, sizeof(VC0706_TimingCount));
+    OS_MutSemGive(VC0706_TimingMutex);
+}
+
+/**
+ * Writes the percentiles of every phase to a CSV file, one row per phase.
+ * \param path - The file to write
+ * \returns 0 on success, -1 if the file could not be written
+ */
+int VC0706_TimingDump(const char *path)
+{
+    char line[96];
+    VC0706_TimingStats_t stats;
+    int status = 0;
+    uint8 phase;
+
+    int32 fd = OS_creat(path, (int32)OS_WRITE_ONLY);
+    if (fd < OS_FS_SUCCESS)
+        return -1;
+
+    int len = snprintf(line, sizeof(line), "phase,samples,p50_us,p90_us,p99_us,max_us\n");
+    if (OS_write(fd, line, (uint32)len) != len)
+        status = -1;
+
+    for (phase = 0; phase < VC0706_PHASE_COUNT && status == 0; phase++)
+    {
+        VC0706_TimingSummary(phase, &stats);
+        len = snprintf(line, sizeof(line), "%s,%u,%u,%u,%u,%u\n", VC0706_PhaseNames[phase], (unsigned int)stats.samples,
+                       (unsigned int)stats.p50Us, (unsigned int)stats.p90Us, (unsigned int)stats.p99Us, (unsigned int)stats.maxUs);
+        if (OS_write(fd, line, (uint32)len) != len)
+            status = -1;
+    }
+
+    OS_close(fd);
+    return status;
+}
@@ -0,0 +1,33 @@
+/**
+ * \file vc0706_timing.h
+ * \brief Header for per-phase capture timing statistics
+ */
+#ifndef _vc0706_timing_h_
+#define _vc0706_timing_h_
+
+#include "vc0706.h"
+
+/** Number of recent samples kept for each phase */
+#define VC0706_TIMING_SAMPLES 256
+/** Where VC0706_DUMP_TIMING_CC writes the timing summary */
+#define VC0706_TIMING_FILE "/ram/logs/vc0706_timing.csv"
+
+/**
+ * Summary of one phase's recent timings
+ */
+typedef struct
+{
+    uint32 samples; /**< Samples the percentiles were taken over */
+    uint32 p50Us;   /**< Median, in microseconds */
+    uint32 p90Us;   /**< 90th percentile, in microseconds */
+    uint32 p99Us;   /**< 99th percentile, in microseconds */
+    uint32 maxUs;   /**< Slowest sample, in microseconds */
+} VC0706_TimingStats_t;
+
+int32 VC0706_TimingInit(void);
+void VC0706_TimingRecord(uint8 phase, uint64_t us);
+void VC0706_TimingSummary(uint8 phase, VC0706_TimingStats_t *stats);
+void VC0706_TimingReset(void);
+int VC0706_TimingDump(const char *path);
+
+#endif
@@ -0,0 +1,653 @@
+/**
+ * \file vc0706_emu.c
+ * \brief Host-side VC0706 camera emulator on a Linux pseudo-terminal
+ *
+ * Answers the VC0706 serial protocol on a pty so the app can be run, timed and regression-tested without camera
+ * hardware. Frames are served from JPEG fixture files, cycling through them one per freeze. Reply latency, link
+ * pacing and byte drop/corruption rates are configurable so throughput changes can be measured under realistic and
+ * hostile link conditions.
+ *
+ * Stand-alone; not part of the cFS app build:
+ *
+ *     gcc -std=gnu99 -O2 -o vc0706_emu tools/vc0706_emu.c
+ *     ./vc0706_emu -l /tmp/vc0706_tty0 frame0.jpg frame1.jpg
+ *
+ * Then build the app with LOCAL_COPTS = -DVC0706_TTY_PATH_FMT='"/tmp/vc0706_tty%d"' so camera 0 opens the emulator.
+ * Run one emulator per camera. Send SIGUSR1 for a statistics line; SIGINT/SIGTERM print it and exit.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The code that signals the beginning of a command */
+#define COMMAND_BEGIN 0x56
+/** The code that signals the beginning of a reply */
+#define COMMAND_SUCCESS 0x76
+
+// Command codes, as in vc0706_core.h
+#define SET_PORT 0x24
+#define RESET 0x26
+#define GEN_VERSION 0x11
+#define READ_DATA 0x30
+#define WRITE_DATA 0x31
+#define READ_FBUF 0x32
+#define GET_FBUF_LEN 0x34
+#define FBUF_CTRL 0x36
+#define COMM_MOTION_CTRL 0x37
+#define COMM_MOTION_STATUS 0x38
+#define COMM_MOTION_DETECTED 0x39
+#define MOTION_CTRL 0x42
+#define MOTION_STATUS 0x43
+#define DOWNSIZE_CTRL 0x54
+#define DOWNSIZE_STATUS 0x55
+
+/** Reply status: command executed */
+#define STATUS_OK 0x00
+/** Reply status: data format error (bad arguments) */
+#define STATUS_FORMAT_ERR 0x03
+/** Reply status: command can't be executed */
+#define STATUS_CANT_EXECUTE 0x04
+
+/** The camera's rate after power-on or reset */
+#define DEFAULT_BAUD 38400
+/** Largest command on the wire: begin, serial, command, length and up to 255 argument bytes */
+#define MAX_COMMAND_LEN (4 + 255)
+/** Most output bytes written in one paced burst */
+#define PACE_BLOCK 64
+/** Most fixtures that can be loaded */
+#define MAX_FIXTURES 64
+
+/** What the camera prints after a reset, as the real module does */
+static const char bootText[] = "\r\nVC0703 1.00\r\nCtrl infr exist\r\nUser-defined sensor\r\n625\r\nInit end\r\n";
+/** The GEN_VERSION payload */
+static const char versionText[] = "VC0703 1.00";
+
+/**
+ * A JPEG frame served by the emulator
+ */
+typedef struct
+{
+    uint8_t *data; /**< The frame bytes */
+    uint32_t len;  /**< The frame length */
+} Fixture_t;
+
+/**
+ * Link conditions and emulated camera state
+ */
+typedef struct
+{
+    // Options
+    const char *link;      /**< Path of the symlink to the pty */
+    uint32_t latencyMs;    /**< Delay before every reply */
+    int64_t fixedRate;     /**< Bytes per second to pace at, 0 for unpaced, or -1 to follow the emulated baud */
+    double dropRate;       /**< Probability of losing each byte sent */
+    double corruptRate;    /**< Probability of flipping a bit in each byte sent */
+    uint32_t motionMs;     /**< Interval between motion alerts while motion reporting is on, 0 for never */
+
+    // Camera state
+    uint32_t baud;         /**< The emulated UART rate */
+    bool frozen;           /**< Whether a frame is held */
+    int frame;             /**< Fixture index of the held (or next) frame */
+    bool commMotion;       /**< Whether motion alerts are sent over serial */
+    uint8_t motionCtrl;    /**< Last MOTION_CTRL setting */
+    uint8_t downsize;      /**< Last DOWNSIZE_CTRL setting */
+    uint8_t compression;   /**< Compression ratio register */
+    uint8_t imageSize;     /**< Image size register */
+
+    // Pacing
+    uint64_t nextSendNs;   /**< Earliest time the next paced block may go out */
+
+    // Statistics
+    uint64_t commands;     /**< Well-formed commands received */
+    uint64_t garbage;      /**< Bytes discarded while looking for a command */
+    uint64_t bytesSent;    /**< Bytes written, including corrupted ones */
+    uint64_t dropped;      /**< Bytes deliberately lost */
+    uint64_t corrupted;    /**< Bytes deliberately corrupted */
+    uint64_t frames;       /**< Frames frozen */
+} Emu_t;
+
+static Fixture_t fixtures[MAX_FIXTURES];
+static int fixtureCount = 0;
+static Emu_t emu;
+static volatile sig_atomic_t stopRequested = 0;
+static volatile sig_atomic_t statsRequested = 0;
+
+/**
+ * Gives the monotonic time in nanoseconds
+ */
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Sleeps until a monotonic time in nanoseconds
+ */
+static void sleepUntil(uint64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ull);
+    ts.tv_nsec = (long)(ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stopRequested)
+        ;
+}
+
+/**
+ * Gives the rate output is currently paced at, in bytes per second, or 0 if unpaced
+ */
+static uint64_t paceRate(void)
+{
+    if (emu.fixedRate >= 0)
+        return (uint64_t)emu.fixedRate;
+    return emu.baud / 10; // start + 8 data + stop bits
+}
+
+/**
+ * Writes bytes to the pty at the paced rate, applying the configured drop and corruption rates
+ */
+static void emit(int fd, const uint8_t *data, uint32_t len)
+{
+    uint8_t block[PACE_BLOCK];
+
+    while (len > 0)
+    {
+        uint32_t take = len < PACE_BLOCK ? len : PACE_BLOCK;
+        uint32_t out = 0;
+        uint32_t i;
+
+        for (i = 0; i < take; i++)
+        {
+            if (emu.dropRate > 0 && drand48() < emu.dropRate)
+            {
+                emu.dropped++;
+                continue;
+            }
+            block[out] = data[i];
+            if (emu.corruptRate > 0 && drand48() < emu.corruptRate)
+            {
+                block[out] ^= (uint8_t)(1u << (lrand48() % 8));
+                emu.corrupted++;
+            }
+            out++;
+        }
+
+        // Hold each block back until the link would have finished sending the previous one
+        uint64_t rate = paceRate();
+        if (rate > 0)
+        {
+            uint64_t now = nowNs();
+            if (emu.nextSendNs < now)
+                emu.nextSendNs = now;
+            sleepUntil(emu.nextSendNs);
+            emu.nextSendNs += (uint64_t)take * 1000000000ull / rate;
+        }
+
+        uint32_t done = 0;
+        while (done < out)
+        {
+            ssize_t n = write(fd, block + done, out - done);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN && !stopRequested)
+                {
+                    struct pollfd pfd = {fd, POLLOUT, 0};
+                    poll(&pfd, 1, 100);
+                    continue;
+                }
+                return; // nobody listening; the bytes are lost as they would be on a real line
+            }
+            done += (uint32_t)n;
+        }
+        emu.bytesSent += out;
+        data += take;
+        len -= take;
+    }
+}
+
+/**
+ * Sends a reply header, honouring the reply latency
+ */
+static void replyHeader(int fd, uint8_t serial, uint8_t cmd, uint8_t status, uint8_t dataLen)
+{
+    if (emu.latencyMs > 0)
+        sleepUntil(nowNs() + (uint64_t)emu.latencyMs * 1000000ull);
+
+    uint8_t hdr[5] = {COMMAND_SUCCESS, serial, cmd, status, dataLen};
+    emit(fd, hdr, sizeof(hdr));
+}
+
+/**
+ * Sends a complete reply: header plus payload
+ */
+static void reply(int fd, uint8_t serial, uint8_t cmd, uint8_t status, const uint8_t *data, uint8_t dataLen)
+{
+    replyHeader(fd, serial, cmd, status, dataLen);
+    if (dataLen > 0)
+        emit(fd, data, dataLen);
+}
+
+/**
+ * Puts the camera back in its power-on state
+ */
+static void powerOn(void)
+{
+    emu.baud = DEFAULT_BAUD;
+    emu.frozen = false;
+    emu.commMotion = false;
+    emu.motionCtrl = 0;
+    emu.downsize = 0x00;
+    emu.compression = 0x36;
+    emu.imageSize = 0x00;
+}
+
+/**
+ * Maps a SET_PORT divider code to the rate it selects
+ * \returns The rate, or 0 for an unknown code
+ */
+static uint32_t dividerBaud(uint8_t hi, uint8_t lo)
+{
+    static const struct
+    {
+        uint8_t hi, lo;
+        uint32_t baud;
+    } codes[] = {
+        {0xAE, 0xC8, 9600}, {0x56, 0xE4, 19200}, {0x2A, 0xF2, 38400}, {0x1C, 0x4C, 57600}, {0x0D, 0xA6, 115200},
+    };
+    size_t i;
+    for (i = 0; i < sizeof(codes) / sizeof(codes[0]); i++)
+    {
+        if (codes[i].hi == hi && codes[i].lo == lo)
+            return codes[i].baud;
+    }
+    return 0;
+}
+
+/**
+ * Carries out one complete command
+ * \param fd - The pty master
+ * \param cmd - The command bytes: begin, serial, command, argument length, arguments
+ */
+static void handleCommand(int fd, const uint8_t *cmd)
+{
+    uint8_t serial = cmd[1];
+    uint8_t code = cmd[2];
+    uint8_t argLen = cmd[3];
+    const uint8_t *args = &cmd[4];
+    const Fixture_t *fx = &fixtures[emu.frame];
+
+    emu.commands++;
+
+    switch (code)
+    {
+    case RESET:
+        reply(fd, serial, code, STATUS_OK, NULL, 0);
+        powerOn();
+        emit(fd, (const uint8_t *)bootText, sizeof(bootText) - 1);
+        break;
+
+    case GEN_VERSION:
+        reply(fd, serial, code, STATUS_OK, (const uint8_t *)versionText, sizeof(versionText) - 1);
+        break;
+
+    case SET_PORT:
+    {
+        // {interface type, divider hi, divider lo}; the acknowledgement goes out at the old rate
+        uint32_t baud = argLen >= 3 ? dividerBaud(args[1], args[2]) : 0;
+        reply(fd, serial, code, baud ? STATUS_OK : STATUS_FORMAT_ERR, NULL, 0);
+        if (baud)
+            emu.baud = baud;
+        break;
+    }
+
+    case FBUF_CTRL:
+        if (argLen < 1)
+        {
+            reply(fd, serial, code, STATUS_FORMAT_ERR, NULL, 0);
+            break;
+        }
+        if (args[0] == 0x00 && !emu.frozen) // stop current frame
+        {
+            emu.frozen = true;
+            emu.frames++;
+        }
+        else if (args[0] == 0x03 && emu.frozen) // resume; the next freeze gets the next fixture
+        {
+            emu.frozen = false;
+            emu.frame = (emu.frame + 1) % fixtureCount;
+        }
+        reply(fd, serial, code, STATUS_OK, NULL, 0);
+        break;
+
+    case GET_FBUF_LEN:
+    {
+        uint8_t len[4] = {(uint8_t)(fx->len >> 24), (uint8_t)(fx->len >> 16), (uint8_t)(fx->len >> 8), (uint8_t)fx->len};
+        reply(fd, serial, code, STATUS_OK, len, sizeof(len));
+        break;
+    }
+
+    case READ_FBUF:
+    {
+        // {type, mode, addr[4], len[4], delay[2]}
+        if (argLen < 10)
+        {
+            reply(fd, serial, code, STATUS_FORMAT_ERR, NULL, 0);
+            break;
+        }
+        uint32_t addr = (uint32_t)args[2] << 24 | (uint32_t)args[3] << 16 | (uint32_t)args[4] << 8 | args[5];
+        uint32_t len = (uint32_t)args[6] << 24 | (uint32_t)args[7] << 16 | (uint32_t)args[8] << 8 | args[9];
+        if (!emu.frozen || addr > fx->len || len > fx->len - addr)
+        {
+            reply(fd, serial, code, STATUS_CANT_EXECUTE, NULL, 0);
+            break;
+        }
+        uint8_t tail[5] = {COMMAND_SUCCESS, serial, code, STATUS_OK, 0x00};
+        replyHeader(fd, serial, code, STATUS_OK, 0);
+        emit(fd, fx->data + addr, len);
+        emit(fd, tail, sizeof(tail));
+        break;
+    }
+
+    case WRITE_DATA:
+        // {type, data length, addr hi, addr lo, data}
+        if (argLen >= 5 && args[2] == 0x12 && args[3] == 0x04)
+            emu.compression = args[4];
+        else if (argLen >= 5 && args[2] == 0x00 && args[3] == 0x19)
+            emu.imageSize = args[4];
+        reply(fd, serial, code, STATUS_OK, NULL, 0);
+        break;
+
+    case READ_DATA:
+    {
+        uint8_t value = 0;
+        if (argLen >= 4 && args[2] == 0x12 && args[3] == 0x04)
+            value = emu.compression;
+        else if (argLen >= 4 && args[2] == 0x00 && args[3] == 0x19)
+            value = emu.imageSize;
+        reply(fd, serial, code, STATUS_OK, &value, 1);
+        break;
+    }
+
+    case DOWNSIZE_CTRL:
+        if (argLen >= 1)
+            emu.downsize = args[0];
+        reply(fd, serial, code, STATUS_OK, NULL, 0);
+        break;
+
+    case DOWNSIZE_STATUS:
+        reply(fd, serial, code, STATUS_OK, &emu.downsize, 1);
+        break;
+
+    case COMM_MOTION_CTRL:
+        if (argLen >= 1)
+            emu.commMotion = args[0] != 0;
+        reply(fd, serial, code, STATUS_OK, NULL, 0);
+        break;
+
+    case COMM_MOTION_STATUS:
+    {
+        uint8_t on = emu.commMotion;
+        reply(fd, serial, code, STATUS_OK, &on, 1);
+        break;
+    }
+
+    case MOTION_CTRL:
+        if (argLen >= 1)
+            emu.motionCtrl = args[argLen - 1];
+        reply(fd, serial, code, STATUS_OK, NULL, 0);
+        break;
+
+    case MOTION_STATUS:
+        reply(fd, serial, code, STATUS_OK, &emu.motionCtrl, 1);
+        break;
+
+    default:
+        reply(fd, serial, code, STATUS_CANT_EXECUTE, NULL, 0);
+        break;
+    }
+}
+
+/**
+ * Loads a fixture file into memory
+ * \returns 0 on success, -1 on failure
+ */
+static int loadFixture(const char *path)
+{
+    if (fixtureCount == MAX_FIXTURES)
+    {
+        fprintf(stderr, "vc0706_emu: too many fixtures, ignoring %s\n", path);
+        return 0;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "vc0706_emu: can't open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size <= 0)
+    {
+        fprintf(stderr, "vc0706_emu: %s is empty\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    Fixture_t *fx = &fixtures[fixtureCount];
+    fx->data = malloc((size_t)size);
+    fx->len = (uint32_t)size;
+    if (fx->data == NULL || fread(fx->data, 1, (size_t)size, f) != (size_t)size)
+    {
+        fprintf(stderr, "vc0706_emu: can't read %s\n", path);
+        free(fx->data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    fixtureCount++;
+    return 0;
+}
+
+/**
+ * Opens a pty and points the link path at its slave end
+ * \param[out] slave - A descriptor held on the slave end so the master keeps working while the app reopens the port
+ * \returns The master descriptor, or -1 on failure
+ */
+static int openPty(int *slave)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        perror("vc0706_emu: posix_openpt");
+        return -1;
+    }
+
+    const char *name = ptsname(master);
+    *slave = open(name, O_RDWR | O_NOCTTY);
+    if (*slave < 0)
+    {
+        perror("vc0706_emu: open slave");
+        return -1;
+    }
+
+    // Binary-clean line, like the camera's UART
+    struct termios tio;
+    tcgetattr(*slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*slave, TCSANOW, &tio);
+
+    unlink(emu.link);
+    if (symlink(name, emu.link) < 0)
+    {
+        fprintf(stderr, "vc0706_emu: can't link %s to %s: %s\n", emu.link, name, strerror(errno));
+        return -1;
+    }
+
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    printf("vc0706_emu: %s -> %s, %d fixture(s)\n", emu.link, name, fixtureCount);
+    return master;
+}
+
+/**
+ * Prints the emulator's counters
+ */
+static void printStats(void)
+{
+    fprintf(stderr,
+            "vc0706_emu: commands %llu garbage %llu frames %llu sent %llu dropped %llu corrupted %llu baud %u\n",
+            (unsigned long long)emu.commands, (unsigned long long)emu.garbage, (unsigned long long)emu.frames,
+            (unsigned long long)emu.bytesSent, (unsigned long long)emu.dropped, (unsigned long long)emu.corrupted,
+            emu.baud);
+}
+
+static void onStop(int sig)
+{
+    (void)sig;
+    stopRequested = 1;
+}
+
+static void onStats(int sig)
+{
+    (void)sig;
+    statsRequested = 1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: vc0706_emu -l LINK [-L latency_ms] [-r bytes_per_sec] [-d drop_rate] [-c corrupt_rate]\n"
+            "                  [-m motion_ms] [-s seed] FIXTURE.jpg...\n"
+            "  -l  path to create as a symlink to the emulated serial port\n"
+            "  -L  delay before every reply, in milliseconds (default 0)\n"
+            "  -r  pace output at this many bytes per second, 0 for unpaced (default: follow emulated baud)\n"
+            "  -d  probability of dropping each byte sent, 0 to 1 (default 0)\n"
+            "  -c  probability of corrupting each byte sent, 0 to 1 (default 0)\n"
+            "  -m  send a motion alert this often while motion reporting is on, in milliseconds (default 0, never)\n"
+            "  -s  random seed for drop and corruption (default 1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    long seed = 1;
+    int opt;
+
+    emu.fixedRate = -1;
+    while ((opt = getopt(argc, argv, "l:L:r:d:c:m:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l': emu.link = optarg; break;
+        case 'L': emu.latencyMs = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': emu.fixedRate = strtoll(optarg, NULL, 0); break;
+        case 'd': emu.dropRate = strtod(optarg, NULL); break;
+        case 'c': emu.corruptRate = strtod(optarg, NULL); break;
+        case 'm': emu.motionMs = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtol(optarg, NULL, 0); break;
+        default: usage(); return 2;
+        }
+    }
+    if (emu.link == NULL || optind == argc)
+    {
+        usage();
+        return 2;
+    }
+    for (; optind < argc; optind++)
+    {
+        if (loadFixture(argv[optind]) == -1)
+            return 1;
+    }
+
+    srand48(seed);
+    powerOn();
+
+    int slave;
+    int master = openPty(&slave);
+    if (master < 0)
+        return 1;
+
+    signal(SIGINT, onStop);
+    signal(SIGTERM, onStop);
+    signal(SIGUSR1, onStats);
+
+    uint8_t cmd[MAX_COMMAND_LEN];
+    uint32_t have = 0;
+    uint64_t nextMotionNs = nowNs() + (uint64_t)emu.motionMs * 1000000ull;
+
+    while (!stopRequested)
+    {
+        if (statsRequested)
+        {
+            statsRequested = 0;
+            printStats();
+        }
+
+        int timeout = -1;
+        if (emu.commMotion && emu.motionMs > 0)
+        {
+            uint64_t now = nowNs();
+            timeout = nextMotionNs > now ? (int)((nextMotionNs - now) / 1000000ull) : 0;
+        }
+
+        struct pollfd pfd = {master, POLLIN, 0};
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno != EINTR)
+            break;
+
+        // Unprompted motion alert, between replies as the camera would send it
+        if (emu.commMotion && emu.motionMs > 0 && nowNs() >= nextMotionNs)
+        {
+            uint8_t alert[5] = {COMMAND_SUCCESS, 0x00, COMM_MOTION_DETECTED, STATUS_OK, 0x00};
+            emit(master, alert, sizeof(alert));
+            nextMotionNs = nowNs() + (uint64_t)emu.motionMs * 1000000ull;
+        }
+        if (ready <= 0)
+            continue;
+
+        ssize_t n = read(master, cmd + have, sizeof(cmd) - have);
+        if (n <= 0)
+            continue;
+        have += (uint32_t)n;
+
+        // Carry out every complete command, resyncing on the begin byte after line noise
+        for (;;)
+        {
+            uint32_t skip = 0;
+            while (skip < have && cmd[skip] != COMMAND_BEGIN)
+                skip++;
+            if (skip > 0)
+            {
+                emu.garbage += skip;
+                memmove(cmd, cmd + skip, have - skip);
+                have -= skip;
+            }
+            if (have < 4 || have < 4u + cmd[3])
+                break;
+
+            uint32_t len = 4u + cmd[3];
+            handleCommand(master, cmd);
+            memmove(cmd, cmd + len, have - len);
+            have -= len;
+        }
+    }
+
+    printStats();
+    unlink(emu.link);
+    close(slave);
+    close(master);
+    return 0;
+}